@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Switching-activity profile for dynamic power estimation.
+ *
+ * Every registered signal is compared with its previous value once per
+ * clock, after the rising edge, and the changed bits are counted. Glitches
+ * between edges are not seen, so counts are those of zero-delay RTL. The
+ * clock itself is not sampled (it toggles twice every cycle).
+ *
+ * Counts are kept per frame and accumulated per VGA mode (ui_in[7:6]); the
+ * report ranks signals by toggles and gives the activity factor, toggles
+ * per bit per cycle, as used by power estimation tools.
+ */
+struct activity_profile {
+	struct signal {
+		std::string name;
+		int width;            // bits, including unpacked elements
+		uint64_t frame_toggles = 0;
+	};
+	struct word {             // up to 8 bytes of a signal, sampled as one
+		const uint8_t* data;
+		uint8_t bytes;
+		uint32_t sig;
+		uint64_t prev;
+	};
+	struct mode_totals {
+		uint64_t frames = 0, cycles = 0;
+		std::vector<uint64_t> toggles;
+	};
+
+	std::vector<signal> sigs;
+	std::vector<word> words;
+	std::map<int, mode_totals> modes;
+	FILE* frames_out = NULL;  // per-frame rows, optional
+
+	// Registers a signal's storage, aliases of an already added net are skipped
+	void add(const std::string& name, const void* data, size_t bytes, int width) {
+		for (auto& w : words) if (w.data == data) return;
+		uint32_t sig = sigs.size();
+		sigs.push_back({ name, width });
+		for (size_t off = 0; off < bytes; off += 8) {
+			word w = { (const uint8_t*)data + off, (uint8_t)std::min<size_t>(8, bytes - off), sig, 0 };
+			memcpy(&w.prev, w.data, w.bytes);
+			words.push_back(w);
+		}
+	}
+
+	bool open_frames(const char* filename) {
+		if (!(frames_out = fopen(filename, "w"))) return false;
+		fprintf(frames_out, "mode,frame,signal,toggles\n");
+		return true;
+	}
+
+	// once per clock
+	void sample() {
+		for (auto& w : words) {
+			uint64_t v = 0;
+			memcpy(&v, w.data, w.bytes);
+			sigs[w.sig].frame_toggles += __builtin_popcountll(v ^ w.prev);
+			w.prev = v;
+		}
+	}
+
+	void end_frame(int mode, int64_t frame, uint64_t cycles) {
+		mode_totals& m = modes[mode];
+		m.toggles.resize(sigs.size());
+		m.frames++;
+		m.cycles += cycles;
+		for (size_t i = 0; i < sigs.size(); i++) {
+			if (frames_out) fprintf(frames_out, "%d,%ld,%s,%lu\n", mode, frame, sigs[i].name.c_str(), sigs[i].frame_toggles);
+			m.toggles[i] += sigs[i].frame_toggles;
+			sigs[i].frame_toggles = 0;
+		}
+	}
+
+	// Ranked CSV, one block of rows per mode
+	bool write_report(const char* filename) const {
+		FILE* f = fopen(filename, "w");
+		if (!f) return false;
+		fprintf(f, "mode,rank,signal,width,toggles,toggles_per_frame,activity\n");
+		for (auto& [mode, m] : modes) {
+			std::vector<uint32_t> order(sigs.size());
+			for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return m.toggles[a] > m.toggles[b]; });
+			int rank = 1;
+			for (uint32_t i : order)
+				fprintf(f, "%d,%d,%s,%d,%lu,%.1f,%.6f\n", mode, rank++, sigs[i].name.c_str(), sigs[i].width, m.toggles[i],
+					(double)m.toggles[i] / m.frames, m.cycles ? (double)m.toggles[i] / m.cycles / sigs[i].width : 0.0);
+		}
+		if (frames_out) fflush(frames_out);
+		return fclose(f) == 0;
+	}
+
+	void close() { if (frames_out) fclose(frames_out); frames_out = NULL; }
+};
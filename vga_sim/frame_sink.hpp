@@ -0,0 +1,187 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "vga_decode.hpp"
+#include "resample.hpp"
+#include "gif.h"
+
+/*
+ * Frame outputs behind one interface. The producer fills a frame taken
+ * from the pipeline's pool and moves it back in; once a batch is full it
+ * is handed to every sink in turn and the buffers return to the pool, so
+ * pixels are never copied on the way. Each sink's time is measured on its
+ * own to see what an output costs.
+ */
+
+struct frame_t {
+	std::vector<ARGB8888_t> pixels;
+	uint64_t index = 0;
+};
+using frame_batch = std::vector<frame_t>;
+
+struct frame_sink {
+	std::string name;
+	uint64_t frames = 0;
+	double seconds = 0;
+
+	frame_sink(const std::string& sink_name) : name(sink_name) {}
+	virtual ~frame_sink() {}
+	virtual void write(const frame_batch& batch) = 0;
+	virtual bool finish() { return true; }
+};
+
+struct null_sink : frame_sink {
+	null_sink() : frame_sink("null") {}
+	void write(const frame_batch&) override {}
+};
+
+// FNV-1a over every pixel of every frame, for regression checks
+struct hash_sink : frame_sink {
+	uint64_t hash = 0xcbf29ce484222325;
+
+	hash_sink() : frame_sink("hash") {}
+	void write(const frame_batch& batch) override {
+		for (auto& f : batch) {
+			const uint8_t* p = (const uint8_t*)f.pixels.data();
+			for (size_t i = 0, n = f.pixels.size() * sizeof(ARGB8888_t); i < n; i++) hash = (hash ^ p[i]) * 0x100000001b3;
+		}
+	}
+	bool finish() override {
+		fprintf(stderr, "Frames hash: %lu frames, fnv1a64 %016lx\n", frames, hash);
+		return true;
+	}
+};
+
+// Each frame's 32-bit pixels appended to a file (for make gif-bench)
+struct raw_sink : frame_sink {
+	FILE* f = NULL;
+
+	raw_sink() : frame_sink("raw") {}
+	~raw_sink() { if (f) fclose(f); }
+	bool open(const char* filename) { return (f = fopen(filename, "wb")) != NULL; }
+	void write(const frame_batch& batch) override {
+		for (auto& fr : batch) fwrite(fr.pixels.data(), sizeof(ARGB8888_t), fr.pixels.size(), f);
+	}
+	bool finish() override {
+		bool ok = !ferror(f) && fclose(f) == 0;
+		f = NULL;
+		return ok;
+	}
+};
+
+// Animated GIF to a file, stdout ("-") or memory ("mem", reports its hash)
+struct gif_sink : frame_sink {
+	GifWriter g;
+	GifBuffer mem = {};
+	std::string out;
+	uint32_t width = 0, height = 0;
+	int delay = 0;
+
+	gif_sink() : frame_sink("gif") {}
+	~gif_sink() { GifBufferFree(&mem); }
+	bool open(const char* filename, uint32_t w, uint32_t h, int frame_delay) {
+		out = filename;
+		width = w;
+		height = h;
+		delay = frame_delay;
+		if (out == "mem") return GifBeginSink(&g, GifWriteMemory, &mem, w, h, delay);
+		if (out == "-") return GifBeginSink(&g, GifWriteFile, stdout, w, h, delay);
+		return GifBegin(&g, filename, w, h, delay);
+	}
+	void write(const frame_batch& batch) override {
+		for (auto& f : batch) GifWriteFrame(&g, (const uint8_t*)f.pixels.data(), width, height, delay);
+	}
+	bool finish() override {
+		if (!GifEnd(&g)) {
+			fprintf(stderr, "Error writing GIF to %s\n", out.c_str());
+			return false;
+		}
+		if (mem.data) { // FNV-1a of the in-memory GIF for regression checks
+			uint64_t hash = 0xcbf29ce484222325;
+			for (size_t i = 0; i < mem.size; i++) hash = (hash ^ mem.data[i]) * 0x100000001b3;
+			fprintf(stderr, "GIF %zu bytes, fnv1a64 %016lx\n", mem.size, hash);
+		}
+		return true;
+	}
+};
+
+// Crops and downscales frames before another sink, e.g. for preview captures
+struct resample_sink : frame_sink {
+	std::unique_ptr<frame_sink> inner;
+	capture_region region;
+	int width;                  // of the incoming frames
+	frame_batch out;
+	std::vector<uint16_t> acc;
+
+	resample_sink(frame_sink* sink, const capture_region& rg, int frame_width)
+		: frame_sink(sink->name + "/" + std::to_string(rg.scale)), inner(sink), region(rg), width(frame_width) {}
+	void write(const frame_batch& batch) override {
+		out.resize(batch.size());
+		for (size_t i = 0; i < batch.size(); i++) {
+			out[i].index = batch[i].index;
+			out[i].pixels.resize((size_t)region.out_w() * region.out_h());
+			const void* src = batch[i].pixels.data();
+			void* dst = out[i].pixels.data();
+			resample(region, (const uint32_t*)src, width, (uint32_t*)dst, acc);
+		}
+		inner->write(out);
+		inner->frames += out.size();
+	}
+	bool finish() override { return inner->finish(); }
+};
+
+struct frame_pipeline {
+	std::vector<std::unique_ptr<frame_sink>> sinks;
+	frame_batch batch, pool;
+	size_t batch_size = 1;
+
+	void add(frame_sink* sink) { sinks.emplace_back(sink); }
+	bool empty() const { return sinks.empty(); }
+
+	// A buffer of n pixels, recycled from delivered frames when possible
+	frame_t take(size_t n) {
+		frame_t f;
+		if (!pool.empty()) {
+			f = std::move(pool.back());
+			pool.pop_back();
+		}
+		f.pixels.resize(n);
+		return f;
+	}
+
+	void submit(frame_t&& f) {
+		batch.push_back(std::move(f));
+		if (batch.size() >= batch_size) flush();
+	}
+
+	void flush() {
+		if (batch.empty()) return;
+		for (auto& s : sinks) {
+			auto t0 = std::chrono::steady_clock::now();
+			s->write(batch);
+			s->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+			s->frames += batch.size();
+		}
+		for (auto& f : batch) pool.push_back(std::move(f));
+		batch.clear();
+	}
+
+	// Delivers the partial batch, closes every sink and reports their cost
+	bool finish() {
+		flush();
+		bool ok = true;
+		for (auto& s : sinks) {
+			auto t0 = std::chrono::steady_clock::now();
+			ok &= s->finish();
+			s->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+			if (s->frames) fprintf(stderr, "Sink %-5s %lu frames, %.3f ms/frame\n", s->name.c_str(), s->frames, s->seconds * 1e3 / s->frames);
+		}
+		sinks.clear();
+		return ok;
+	}
+};
@@ -20,6 +20,9 @@
 // to automatically flip the buffer data when writing the image (the buffer itself is
 // unchanged.
 //
+// Change detection between frames uses AVX2 or SSE2 when the compiler targets them.
+// Define GIF_NO_SIMD to force the scalar code; the output bytes are identical.
+//
 // USAGE:
 // Create a GifWriter struct. Pass it to GifBegin() to initialize and write the header.
 // Pass subsequent frames to GifWriteFrame().
@@ -38,7 +41,7 @@
 // TEMP_MALLOC and TEMP_FREE will only be called in stack fashion - frees in the reverse order of mallocs
 // and any temp memory allocated by a function will be freed before it exits.
 // MALLOC and FREE are used only by GifBegin and GifEnd respectively (to allocate a buffer the size of the image, which
-// is used to find changed pixels for delta-encoding.)
+// is used to find changed pixels for delta-encoding, the LZW dictionary and the frame output buffer.)
 
 #ifndef GIF_TEMP_MALLOC
 #include <stdlib.h>
@@ -60,6 +63,14 @@
 #define GIF_FREE free
 #endif
 
+#if !defined(GIF_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define GIF_SIMD_WIDTH 8
+#elif !defined(GIF_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define GIF_SIMD_WIDTH 4
+#endif
+
 const int kGifTransIndex = 0;
 
 typedef struct
@@ -348,6 +359,24 @@ void GifSplitPalette(uint8_t* image, int numPixels, int treeNode, int treeLevel,
     GifSplitPalette(image+subPixelsA*4, subPixelsB, treeNode*2+1, treeLevel+1, buildForDither, pal);
 }
 
+#ifdef GIF_SIMD_WIDTH
+// Returns a bitmask of which of the next GIF_SIMD_WIDTH pixels differ in RGB (alpha is ignored)
+uint32_t GifChangedMask( const uint8_t* lastFrame, const uint8_t* frame )
+{
+#if GIF_SIMD_WIDTH == 8
+    __m256i diff = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)lastFrame), _mm256_loadu_si256((const __m256i*)frame));
+    diff = _mm256_and_si256(diff, _mm256_set1_epi32(0x00ffffff));
+    __m256i same = _mm256_cmpeq_epi32(diff, _mm256_setzero_si256());
+    return ~(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(same)) & 0xff;
+#else
+    __m128i diff = _mm_xor_si128(_mm_loadu_si128((const __m128i*)lastFrame), _mm_loadu_si128((const __m128i*)frame));
+    diff = _mm_and_si128(diff, _mm_set1_epi32(0x00ffffff));
+    __m128i same = _mm_cmpeq_epi32(diff, _mm_setzero_si128());
+    return ~(uint32_t)_mm_movemask_ps(_mm_castsi128_ps(same)) & 0xf;
+#endif
+}
+#endif
+
 // Finds all pixels that have changed from the previous image and
 // moves them to the fromt of th buffer.
 // This allows us to build a palette optimized for the colors of the
@@ -356,8 +385,39 @@ int GifPickChangedPixels( const uint8_t* lastFrame, uint8_t* frame, int numPixel
 {
     int numChanged = 0;
     uint8_t* writeIter = frame;
+    int ii=0;
+
+#ifdef GIF_SIMD_WIDTH
+    const uint32_t allChanged = (1u << GIF_SIMD_WIDTH) - 1;
+    for (; ii+GIF_SIMD_WIDTH<=numPixels; ii+=GIF_SIMD_WIDTH)
+    {
+        uint32_t mask = GifChangedMask(lastFrame, frame);
+        if(mask == allChanged && writeIter == frame)
+        {
+            // nothing skipped yet, the pixels are already in place
+            numChanged += GIF_SIMD_WIDTH;
+            writeIter += 4*GIF_SIMD_WIDTH;
+        }
+        else if(mask)
+        {
+            for (int jj=0; jj<GIF_SIMD_WIDTH; ++jj)
+            {
+                if(mask & (1u << jj))
+                {
+                    writeIter[0] = frame[jj*4+0];
+                    writeIter[1] = frame[jj*4+1];
+                    writeIter[2] = frame[jj*4+2];
+                    ++numChanged;
+                    writeIter += 4;
+                }
+            }
+        }
+        lastFrame += 4*GIF_SIMD_WIDTH;
+        frame += 4*GIF_SIMD_WIDTH;
+    }
+#endif
 
-    for (int ii=0; ii<numPixels; ++ii)
+    for (; ii<numPixels; ++ii)
     {
         if(lastFrame[0] != frame[0] ||
            lastFrame[1] != frame[1] ||
@@ -378,14 +438,17 @@ int GifPickChangedPixels( const uint8_t* lastFrame, uint8_t* frame, int numPixel
 
 // Creates a palette by placing all the image pixels in a k-d tree and then averaging the blocks at the bottom.
 // This is known as the "median split" technique
-void GifMakePalette( const uint8_t* lastFrame, const uint8_t* nextFrame, uint32_t width, uint32_t height, int bitDepth, bool buildForDither, GifPalette* pPal )
+// If scratch is given it must hold width*height*4 bytes, otherwise temp memory is allocated.
+void GifMakePalette( const uint8_t* lastFrame, const uint8_t* nextFrame, uint32_t width, uint32_t height, int bitDepth, bool buildForDither, GifPalette* pPal, uint8_t* scratch = NULL )
 {
+    // leaves that receive no pixels are never written, zero them so the output is deterministic
+    memset(pPal, 0, sizeof(GifPalette));
     pPal->bitDepth = bitDepth;
 
     // SplitPalette is destructive (it sorts the pixels by color) so
     // we must create a copy of the image for it to destroy
     size_t imageSize = (size_t)(width * height * 4 * sizeof(uint8_t));
-    uint8_t* destroyableImage = (uint8_t*)GIF_TEMP_MALLOC(imageSize);
+    uint8_t* destroyableImage = scratch? scratch : (uint8_t*)GIF_TEMP_MALLOC(imageSize);
     memcpy(destroyableImage, nextFrame, imageSize);
 
     int numPixels = (int)(width * height);
@@ -394,7 +457,7 @@ void GifMakePalette( const uint8_t* lastFrame, const uint8_t* nextFrame, uint32_
 
     GifSplitPalette(destroyableImage, numPixels, 1, 0, buildForDither, pPal);
 
-    GIF_TEMP_FREE(destroyableImage);
+    if(!scratch) GIF_TEMP_FREE(destroyableImage);
 
     // add the bottom node for the transparency index
     pPal->treeSplit[1 << (bitDepth-1)] = 0;
@@ -512,37 +575,86 @@ void GifDitherImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint8_t
     GIF_TEMP_FREE(quantPixels);
 }
 
+// Palettizes one pixel for GifThresholdImage. Frames hold few distinct colors,
+// so the last lookup is cached (the tree search result depends only on the color).
+void GifThresholdPixel( const uint8_t* lastPix, const uint8_t* nextPix, uint8_t* outPix, GifPalette* pPal, uint32_t* cacheColor, int32_t* cacheInd )
+{
+    // if a previous color is available, and it matches the current color,
+    // set the pixel to transparent
+    if(lastPix &&
+       lastPix[0] == nextPix[0] &&
+       lastPix[1] == nextPix[1] &&
+       lastPix[2] == nextPix[2])
+    {
+        outPix[0] = lastPix[0];
+        outPix[1] = lastPix[1];
+        outPix[2] = lastPix[2];
+        outPix[3] = kGifTransIndex;
+        return;
+    }
+
+    // palettize the pixel
+    uint32_t color = (uint32_t)nextPix[0] | (uint32_t)nextPix[1] << 8 | (uint32_t)nextPix[2] << 16;
+    int32_t bestInd = *cacheInd;
+    if(color != *cacheColor)
+    {
+        int32_t bestDiff = 1000000;
+        bestInd = 1;
+        GifGetClosestPaletteColor(pPal, nextPix[0], nextPix[1], nextPix[2], &bestInd, &bestDiff, 1);
+        *cacheColor = color;
+        *cacheInd = bestInd;
+    }
+
+    // Write the resulting color to the output buffer
+    outPix[0] = pPal->r[bestInd];
+    outPix[1] = pPal->g[bestInd];
+    outPix[2] = pPal->b[bestInd];
+    outPix[3] = (uint8_t)bestInd;
+}
+
 // Picks palette colors for the image using simple thresholding, no dithering
 void GifThresholdImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint8_t* outFrame, uint32_t width, uint32_t height, GifPalette* pPal )
 {
     uint32_t numPixels = width*height;
-    for( uint32_t ii=0; ii<numPixels; ++ii )
+    uint32_t cacheColor = 0xffffffff; // no valid color has the top byte set
+    int32_t cacheInd = 1;
+    uint32_t ii=0;
+
+#ifdef GIF_SIMD_WIDTH
+    if(lastFrame)
     {
-        // if a previous color is available, and it matches the current color,
-        // set the pixel to transparent
-        if(lastFrame &&
-           lastFrame[0] == nextFrame[0] &&
-           lastFrame[1] == nextFrame[1] &&
-           lastFrame[2] == nextFrame[2])
-        {
-            outFrame[0] = lastFrame[0];
-            outFrame[1] = lastFrame[1];
-            outFrame[2] = lastFrame[2];
-            outFrame[3] = kGifTransIndex;
-        }
-        else
+        for (; ii+GIF_SIMD_WIDTH<=numPixels; ii+=GIF_SIMD_WIDTH)
         {
-            // palettize the pixel
-            int32_t bestDiff = 1000000;
-            int32_t bestInd = 1;
-            GifGetClosestPaletteColor(pPal, nextFrame[0], nextFrame[1], nextFrame[2], &bestInd, &bestDiff, 1);
-
-            // Write the resulting color to the output buffer
-            outFrame[0] = pPal->r[bestInd];
-            outFrame[1] = pPal->g[bestInd];
-            outFrame[2] = pPal->b[bestInd];
-            outFrame[3] = (uint8_t)bestInd;
+            uint32_t mask = GifChangedMask(lastFrame, nextFrame);
+            if(!mask)
+            {
+                // whole block unchanged: keep the previous color, transparent index in alpha
+                // (outFrame may alias lastFrame, the block is loaded before it is stored)
+#if GIF_SIMD_WIDTH == 8
+                __m256i last = _mm256_loadu_si256((const __m256i*)lastFrame);
+                last = _mm256_and_si256(last, _mm256_set1_epi32(0x00ffffff));
+                _mm256_storeu_si256((__m256i*)outFrame, _mm256_or_si256(last, _mm256_set1_epi32(kGifTransIndex << 24)));
+#else
+                __m128i last = _mm_loadu_si128((const __m128i*)lastFrame);
+                last = _mm_and_si128(last, _mm_set1_epi32(0x00ffffff));
+                _mm_storeu_si128((__m128i*)outFrame, _mm_or_si128(last, _mm_set1_epi32(kGifTransIndex << 24)));
+#endif
+            }
+            else
+            {
+                for (int jj=0; jj<GIF_SIMD_WIDTH; ++jj)
+                    GifThresholdPixel(lastFrame+jj*4, nextFrame+jj*4, outFrame+jj*4, pPal, &cacheColor, &cacheInd);
+            }
+            lastFrame += 4*GIF_SIMD_WIDTH;
+            outFrame += 4*GIF_SIMD_WIDTH;
+            nextFrame += 4*GIF_SIMD_WIDTH;
         }
+    }
+#endif
+
+    for (; ii<numPixels; ++ii)
+    {
+        GifThresholdPixel(lastFrame, nextFrame, outFrame, pPal, &cacheColor, &cacheInd);
 
         if(lastFrame) lastFrame += 4;
         outFrame += 4;
@@ -550,137 +662,189 @@ void GifThresholdImage( const uint8_t* lastFrame, const uint8_t* nextFrame, uint
     }
 }
 
-// Simple structure to write out the LZW-compressed portion of the image
-// one bit at a time
+// Growable in-memory byte buffer. Each frame is assembled here and then
+// written to the file with a single fwrite.
 typedef struct
 {
-    uint32_t chunkIndex;
-    uint8_t chunk[256];   // bytes are written in here until we have 256 of them, then written to the file
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} GifBuffer;
+
+// make room for at least extra more bytes
+void GifBufferReserve( GifBuffer* buf, size_t extra )
+{
+    if( buf->size + extra <= buf->capacity ) return;
 
-    uint8_t bitIndex;  // how many bits in the partial byte written so far
-    uint8_t byte;      // current partial byte
+    size_t capacity = buf->capacity? buf->capacity : 4096;
+    while( capacity < buf->size + extra ) capacity *= 2;
 
-    uint8_t padding[2];    // make padding explicit
-} GifBitStatus;
+    uint8_t* data = (uint8_t*)GIF_MALLOC(capacity);
+    if( buf->size ) memcpy(data, buf->data, buf->size);
+    if( buf->data ) GIF_FREE(buf->data);
+    buf->data = data;
+    buf->capacity = capacity;
+}
 
-// insert a single bit
-void GifWriteBit( GifBitStatus* stat, uint32_t bit )
+void GifBufferPut( GifBuffer* buf, uint8_t byte )
 {
-    bit = bit & 1;
-    bit = bit << stat->bitIndex;
-    stat->byte |= bit;
+    if( buf->size == buf->capacity ) GifBufferReserve(buf, 1);
+    buf->data[buf->size++] = byte;
+}
 
-    ++stat->bitIndex;
-    if( stat->bitIndex > 7 )
-    {
-        // move the newly-finished byte to the chunk buffer
-        stat->chunk[stat->chunkIndex++] = stat->byte;
-        // and start a new byte
-        stat->bitIndex = 0;
-        stat->byte = 0;
-    }
+void GifBufferWrite( GifBuffer* buf, const void* data, size_t size )
+{
+    GifBufferReserve(buf, size);
+    memcpy(buf->data + buf->size, data, size);
+    buf->size += size;
 }
 
-// write all bytes so far to the file
-void GifWriteChunk( FILE* f, GifBitStatus* stat )
+void GifBufferFree( GifBuffer* buf )
 {
-    fputc((int)stat->chunkIndex, f);
-    fwrite(stat->chunk, 1, stat->chunkIndex, f);
+    if( buf->data ) GIF_FREE(buf->data);
+    buf->data = NULL;
+    buf->size = buf->capacity = 0;
+}
+
+// Simple structure to write out the LZW-compressed portion of the image.
+// Codes are packed into a bit accumulator and flushed a byte at a time.
+typedef struct
+{
+    uint32_t chunkIndex;
+    uint8_t chunk[256];   // bytes are written in here until we have 255 of them, then written to the buffer
+
+    uint32_t bits;        // pending bits, least significant first
+    uint32_t bitCount;    // how many pending bits
+} GifBitStatus;
+
+// write all bytes so far to the buffer
+void GifWriteChunk( GifBuffer* buf, GifBitStatus* stat )
+{
+    GifBufferPut(buf, (uint8_t)stat->chunkIndex);
+    GifBufferWrite(buf, stat->chunk, stat->chunkIndex);
 
-    stat->bitIndex = 0;
-    stat->byte = 0;
     stat->chunkIndex = 0;
 }
 
-void GifWriteCode( FILE* f, GifBitStatus* stat, uint32_t code, uint32_t length )
+void GifWriteCode( GifBuffer* buf, GifBitStatus* stat, uint32_t code, uint32_t length )
 {
-    for( uint32_t ii=0; ii<length; ++ii )
+    stat->bits |= code << stat->bitCount;
+    stat->bitCount += length;
+
+    while( stat->bitCount >= 8 )
     {
-        GifWriteBit(stat, code);
-        code = code >> 1;
+        // move the newly-finished byte to the chunk buffer
+        stat->chunk[stat->chunkIndex++] = (uint8_t)stat->bits;
+        stat->bits >>= 8;
+        stat->bitCount -= 8;
 
         if( stat->chunkIndex == 255 )
         {
-            GifWriteChunk(f, stat);
+            GifWriteChunk(buf, stat);
         }
     }
 }
 
-// The LZW dictionary is a 256-ary tree constructed as the file is encoded,
-// this is one node
+// The LZW dictionary is an open-addressed hash table from (prefix code, next index)
+// to code. Keys carry a generation stamp, so clearing the dictionary only bumps
+// the generation instead of touching the whole table.
+const int kGifLzwHashBits = 13;
+const int kGifLzwHashSize = 1 << kGifLzwHashBits; // 2x the 4096 codes, keeps probes short
+
 typedef struct
 {
-    uint16_t m_next[256];
-} GifLzwNode;
+    uint32_t m_key[kGifLzwHashSize];  // generation << 20 | prefix << 8 | index
+    uint16_t m_code[kGifLzwHashSize];
+    uint32_t m_gen;                   // current generation, [1, 4095]
+} GifLzwDict;
 
-// write a 256-color (8-bit) image palette to the file
-void GifWritePalette( const GifPalette* pPal, FILE* f )
+void GifLzwClear( GifLzwDict* dict )
 {
-    fputc(0, f);  // first color: transparency
-    fputc(0, f);
-    fputc(0, f);
+    if( ++dict->m_gen >= 4096 || dict->m_gen == 1 )
+    {
+        // generation wrapped (or first use), reset stamps so old keys can't match
+        memset(dict->m_key, 0, sizeof(dict->m_key));
+        dict->m_gen = 1;
+    }
+}
 
-    for(int ii=1; ii<(1 << pPal->bitDepth); ++ii)
+// returns the slot for (prefix, index): either the matching entry or the empty slot to insert into
+uint32_t GifLzwFind( const GifLzwDict* dict, uint32_t prefix, uint32_t index, uint32_t* key )
+{
+    *key = dict->m_gen << 20 | prefix << 8 | index;
+    uint32_t slot = ((prefix << 8 | index) * 2654435761u) >> (32 - kGifLzwHashBits);
+    for(;;)
     {
-        uint32_t r = pPal->r[ii];
-        uint32_t g = pPal->g[ii];
-        uint32_t b = pPal->b[ii];
+        uint32_t k = dict->m_key[slot];
+        if( k == *key || (k >> 20) != dict->m_gen ) return slot;
+        slot = (slot + 1) & (kGifLzwHashSize - 1);
+    }
+}
+
+// write a 256-color (8-bit) image palette to the buffer
+void GifWritePalette( const GifPalette* pPal, GifBuffer* buf )
+{
+    GifBufferReserve(buf, 3u << pPal->bitDepth);
+
+    GifBufferPut(buf, 0);  // first color: transparency
+    GifBufferPut(buf, 0);
+    GifBufferPut(buf, 0);
 
-        fputc((int)r, f);
-        fputc((int)g, f);
-        fputc((int)b, f);
+    for(int ii=1; ii<(1 << pPal->bitDepth); ++ii)
+    {
+        GifBufferPut(buf, pPal->r[ii]);
+        GifBufferPut(buf, pPal->g[ii]);
+        GifBufferPut(buf, pPal->b[ii]);
     }
 }
 
 // write the image header, LZW-compress and write out the image
-void GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uint32_t width, uint32_t height, uint32_t delay, GifPalette* pPal)
+void GifWriteLzwImage(GifBuffer* buf, GifLzwDict* dict, uint8_t* image, uint32_t left, uint32_t top,  uint32_t width, uint32_t height, uint32_t delay, GifPalette* pPal)
 {
     // graphics control extension
-    fputc(0x21, f);
-    fputc(0xf9, f);
-    fputc(0x04, f);
-    fputc(0x05, f); // leave prev frame in place, this frame has transparency
-    fputc(delay & 0xff, f);
-    fputc((delay >> 8) & 0xff, f);
-    fputc(kGifTransIndex, f); // transparent color index
-    fputc(0, f);
+    GifBufferPut(buf, 0x21);
+    GifBufferPut(buf, 0xf9);
+    GifBufferPut(buf, 0x04);
+    GifBufferPut(buf, 0x05); // leave prev frame in place, this frame has transparency
+    GifBufferPut(buf, delay & 0xff);
+    GifBufferPut(buf, (delay >> 8) & 0xff);
+    GifBufferPut(buf, kGifTransIndex); // transparent color index
+    GifBufferPut(buf, 0);
 
-    fputc(0x2c, f); // image descriptor block
+    GifBufferPut(buf, 0x2c); // image descriptor block
 
-    fputc(left & 0xff, f);           // corner of image in canvas space
-    fputc((left >> 8) & 0xff, f);
-    fputc(top & 0xff, f);
-    fputc((top >> 8) & 0xff, f);
+    GifBufferPut(buf, left & 0xff);           // corner of image in canvas space
+    GifBufferPut(buf, (left >> 8) & 0xff);
+    GifBufferPut(buf, top & 0xff);
+    GifBufferPut(buf, (top >> 8) & 0xff);
 
-    fputc(width & 0xff, f);          // width and height of image
-    fputc((width >> 8) & 0xff, f);
-    fputc(height & 0xff, f);
-    fputc((height >> 8) & 0xff, f);
+    GifBufferPut(buf, width & 0xff);          // width and height of image
+    GifBufferPut(buf, (width >> 8) & 0xff);
+    GifBufferPut(buf, height & 0xff);
+    GifBufferPut(buf, (height >> 8) & 0xff);
 
-    //fputc(0, f); // no local color table, no transparency
-    //fputc(0x80, f); // no local color table, but transparency
+    //GifBufferPut(buf, 0); // no local color table, no transparency
+    //GifBufferPut(buf, 0x80); // no local color table, but transparency
 
-    fputc(0x80 + pPal->bitDepth-1, f); // local color table present, 2 ^ bitDepth entries
-    GifWritePalette(pPal, f);
+    GifBufferPut(buf, 0x80 + pPal->bitDepth-1); // local color table present, 2 ^ bitDepth entries
+    GifWritePalette(pPal, buf);
 
     const int minCodeSize = pPal->bitDepth;
     const uint32_t clearCode = 1 << pPal->bitDepth;
 
-    fputc(minCodeSize, f); // min code size 8 bits
+    GifBufferPut(buf, minCodeSize); // min code size 8 bits
 
-    GifLzwNode* codetree = (GifLzwNode*)GIF_TEMP_MALLOC(sizeof(GifLzwNode)*4096);
-
-    memset(codetree, 0, sizeof(GifLzwNode)*4096);
+    GifLzwClear(dict);
     int32_t curCode = -1;
     uint32_t codeSize = (uint32_t)minCodeSize + 1;
     uint32_t maxCode = clearCode+1;
 
     GifBitStatus stat;
-    stat.byte = 0;
-    stat.bitIndex = 0;
+    stat.bits = 0;
+    stat.bitCount = 0;
     stat.chunkIndex = 0;
 
-    GifWriteCode(f, &stat, clearCode, codeSize);  // start with a fresh LZW dictionary
+    GifWriteCode(buf, &stat, clearCode, codeSize);  // start with a fresh LZW dictionary
 
     for(uint32_t yy=0; yy<height; ++yy)
     {
@@ -695,26 +859,31 @@ void GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uin
     #endif
 
             // "worst possible mode" - no compression, every single code is followed immediately by a clear
-            //WriteCode( f, stat, nextValue, codeSize );
-            //WriteCode( f, stat, 256, codeSize );
+            //WriteCode( buf, stat, nextValue, codeSize );
+            //WriteCode( buf, stat, 256, codeSize );
 
             if( curCode < 0 )
             {
                 // first value in a new run
                 curCode = nextValue;
+                continue;
             }
-            else if( codetree[curCode].m_next[nextValue] )
+
+            uint32_t key;
+            uint32_t slot = GifLzwFind(dict, (uint32_t)curCode, nextValue, &key);
+            if( dict->m_key[slot] == key )
             {
                 // current run already in the dictionary
-                curCode = codetree[curCode].m_next[nextValue];
+                curCode = dict->m_code[slot];
             }
             else
             {
                 // finish the current run, write a code
-                GifWriteCode(f, &stat, (uint32_t)curCode, codeSize);
+                GifWriteCode(buf, &stat, (uint32_t)curCode, codeSize);
 
                 // insert the new run into the dictionary
-                codetree[curCode].m_next[nextValue] = (uint16_t)++maxCode;
+                dict->m_key[slot] = key;
+                dict->m_code[slot] = (uint16_t)++maxCode;
 
                 if( maxCode >= (1ul << codeSize) )
                 {
@@ -725,9 +894,9 @@ void GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uin
                 if( maxCode == 4095 )
                 {
                     // the dictionary is full, clear it out and begin anew
-                    GifWriteCode(f, &stat, clearCode, codeSize); // clear tree
+                    GifWriteCode(buf, &stat, clearCode, codeSize); // clear tree
 
-                    memset(codetree, 0, sizeof(GifLzwNode)*4096);
+                    GifLzwClear(dict);
                     codeSize = (uint32_t)(minCodeSize + 1);
                     maxCode = clearCode+1;
                 }
@@ -738,86 +907,143 @@ void GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uin
     }
 
     // compression footer
-    GifWriteCode(f, &stat, (uint32_t)curCode, codeSize);
-    GifWriteCode(f, &stat, clearCode, codeSize);
-    GifWriteCode(f, &stat, clearCode + 1, (uint32_t)minCodeSize + 1);
+    GifWriteCode(buf, &stat, (uint32_t)curCode, codeSize);
+    GifWriteCode(buf, &stat, clearCode, codeSize);
+    GifWriteCode(buf, &stat, clearCode + 1, (uint32_t)minCodeSize + 1);
+
+    // write out the last partial byte and chunk
+    if( stat.bitCount ) GifWriteCode(buf, &stat, 0, 8 - stat.bitCount);
+    if( stat.chunkIndex ) GifWriteChunk(buf, &stat);
 
-    // write out the last partial chunk
-    while( stat.bitIndex ) GifWriteBit(&stat, 0);
-    if( stat.chunkIndex ) GifWriteChunk(f, &stat);
+    GifBufferPut(buf, 0); // image block terminator
+}
 
-    fputc(0, f); // image block terminator
+// Output sink for the encoded GIF stream. Returns false on a write error.
+typedef bool (*GifWriteFunc)( void* user, const void* data, size_t size );
 
-    GIF_TEMP_FREE(codetree);
+// sink for stdio files
+bool GifWriteFile( void* user, const void* data, size_t size )
+{
+    return fwrite(data, 1, size, (FILE*)user) == size;
+}
+
+// sink that appends to a caller-owned GifBuffer (free it with GifBufferFree)
+bool GifWriteMemory( void* user, const void* data, size_t size )
+{
+    GifBufferWrite((GifBuffer*)user, data, size);
+    return true;
 }
 
 typedef struct
 {
-    FILE* f;
+    GifWriteFunc write;   // output sink and its user data
+    void* user;
+    FILE* f;              // file opened by GifBegin, closed by GifEnd
     uint8_t* oldImage;
+    uint8_t* tempImage;   // scratch copy of the frame for palette building
+    GifLzwDict* dict;     // reused by every frame
+    GifBuffer buf;        // encoded frame, handed to the sink in one write
     bool firstFrame;
-
-    uint8_t padding[7];    // make padding explicit
+    bool ok;              // false once the sink has failed
 } GifWriter;
 
-// Creates a gif file.
+// hands the assembled bytes to the sink and empties the buffer
+bool GifFlush( GifWriter* writer )
+{
+    if( writer->buf.size && !writer->write(writer->user, writer->buf.data, writer->buf.size) )
+        writer->ok = false;
+    writer->buf.size = 0;
+    return writer->ok;
+}
+
+// Starts a gif written through a sink.
 // The input GIFWriter is assumed to be uninitialized.
 // The delay value is the time between frames in hundredths of a second - note that not all viewers pay much attention to this value.
-bool GifBegin( GifWriter* writer, const char* filename, uint32_t width, uint32_t height, uint32_t delay, int32_t bitDepth = 8, bool dither = false )
+bool GifBeginSink( GifWriter* writer, GifWriteFunc write, void* user, uint32_t width, uint32_t height, uint32_t delay, int32_t bitDepth = 8, bool dither = false )
 {
     (void)bitDepth; (void)dither; // Mute "Unused argument" warnings
-#if defined(_MSC_VER) && (_MSC_VER >= 1400)
-	writer->f = 0;
-    fopen_s(&writer->f, filename, "wb");
-#else
-    writer->f = fopen(filename, "wb");
-#endif
-    if(!writer->f) return false;
+    writer->write = NULL; // GifWriteFrame and GifEnd are no-ops after a failed begin
+    writer->f = NULL;
+    writer->ok = false;
+    if(!write) return false;
 
+    writer->write = write;
+    writer->user = user;
+    writer->f = NULL;
     writer->firstFrame = true;
+    writer->ok = true;
 
     // allocate
     writer->oldImage = (uint8_t*)GIF_MALLOC(width*height*4);
+    writer->tempImage = (uint8_t*)GIF_MALLOC(width*height*4);
+    writer->dict = (GifLzwDict*)GIF_MALLOC(sizeof(GifLzwDict));
+    writer->dict->m_gen = 0;
+    writer->buf.data = NULL;
+    writer->buf.size = writer->buf.capacity = 0;
+    GifBufferReserve(&writer->buf, width*height + 1024);
 
-    fputs("GIF89a", writer->f);
+    GifBuffer* buf = &writer->buf;
+    GifBufferWrite(buf, "GIF89a", 6);
 
     // screen descriptor
-    fputc(width & 0xff, writer->f);
-    fputc((width >> 8) & 0xff, writer->f);
-    fputc(height & 0xff, writer->f);
-    fputc((height >> 8) & 0xff, writer->f);
+    GifBufferPut(buf, width & 0xff);
+    GifBufferPut(buf, (width >> 8) & 0xff);
+    GifBufferPut(buf, height & 0xff);
+    GifBufferPut(buf, (height >> 8) & 0xff);
 
-    fputc(0xf0, writer->f);  // there is an unsorted global color table of 2 entries
-    fputc(0, writer->f);     // background color
-    fputc(0, writer->f);     // pixels are square (we need to specify this because it's 1989)
+    GifBufferPut(buf, 0xf0);  // there is an unsorted global color table of 2 entries
+    GifBufferPut(buf, 0);     // background color
+    GifBufferPut(buf, 0);     // pixels are square (we need to specify this because it's 1989)
 
     // now the "global" palette (really just a dummy palette)
     // color 0: black
-    fputc(0, writer->f);
-    fputc(0, writer->f);
-    fputc(0, writer->f);
+    GifBufferPut(buf, 0);
+    GifBufferPut(buf, 0);
+    GifBufferPut(buf, 0);
     // color 1: also black
-    fputc(0, writer->f);
-    fputc(0, writer->f);
-    fputc(0, writer->f);
+    GifBufferPut(buf, 0);
+    GifBufferPut(buf, 0);
+    GifBufferPut(buf, 0);
 
     if( delay != 0 )
     {
         // animation header
-        fputc(0x21, writer->f); // extension
-        fputc(0xff, writer->f); // application specific
-        fputc(11, writer->f); // length 11
-        fputs("NETSCAPE2.0", writer->f); // yes, really
-        fputc(3, writer->f); // 3 bytes of NETSCAPE2.0 data
+        GifBufferPut(buf, 0x21); // extension
+        GifBufferPut(buf, 0xff); // application specific
+        GifBufferPut(buf, 11); // length 11
+        GifBufferWrite(buf, "NETSCAPE2.0", 11); // yes, really
+        GifBufferPut(buf, 3); // 3 bytes of NETSCAPE2.0 data
 
-        fputc(1, writer->f); // this is the Netscape 2.0 sub-block ID and it must be 1, otherwise some viewers error
-        fputc(0, writer->f); // loop infinitely (byte 0)
-        fputc(0, writer->f); // loop infinitely (byte 1)
+        GifBufferPut(buf, 1); // this is the Netscape 2.0 sub-block ID and it must be 1, otherwise some viewers error
+        GifBufferPut(buf, 0); // loop infinitely (byte 0)
+        GifBufferPut(buf, 0); // loop infinitely (byte 1)
 
-        fputc(0, writer->f); // block terminator
+        GifBufferPut(buf, 0); // block terminator
     }
 
-    return true;
+    return GifFlush(writer);
+}
+
+// Creates a gif file.
+// The input GIFWriter is assumed to be uninitialized.
+// The delay value is the time between frames in hundredths of a second - note that not all viewers pay much attention to this value.
+bool GifBegin( GifWriter* writer, const char* filename, uint32_t width, uint32_t height, uint32_t delay, int32_t bitDepth = 8, bool dither = false )
+{
+    FILE* f;
+#if defined(_MSC_VER) && (_MSC_VER >= 1400)
+    f = 0;
+    fopen_s(&f, filename, "wb");
+#else
+    f = fopen(filename, "wb");
+#endif
+    writer->write = NULL;
+    writer->f = NULL;
+    writer->ok = false;
+    if(!f) return false;
+
+    bool ok = GifBeginSink(writer, GifWriteFile, f, width, height, delay, bitDepth, dither);
+    writer->f = f;
+    return ok;
 }
 
 // Writes out a new frame to a GIF in progress.
@@ -826,39 +1052,47 @@ bool GifBegin( GifWriter* writer, const char* filename, uint32_t width, uint32_t
 // this may be handy to save bits in animations that don't change much.
 bool GifWriteFrame( GifWriter* writer, const uint8_t* image, uint32_t width, uint32_t height, uint32_t delay, int bitDepth = 8, bool dither = false )
 {
-    if(!writer->f) return false;
+    if(!writer->write || !writer->ok) return false;
 
     const uint8_t* oldImage = writer->firstFrame? NULL : writer->oldImage;
     writer->firstFrame = false;
 
     GifPalette pal;
-    GifMakePalette((dither? NULL : oldImage), image, width, height, bitDepth, dither, &pal);
+    GifMakePalette((dither? NULL : oldImage), image, width, height, bitDepth, dither, &pal, writer->tempImage);
 
     if(dither)
         GifDitherImage(oldImage, image, writer->oldImage, width, height, &pal);
     else
         GifThresholdImage(oldImage, image, writer->oldImage, width, height, &pal);
 
-    GifWriteLzwImage(writer->f, writer->oldImage, 0, 0, width, height, delay, &pal);
+    GifWriteLzwImage(&writer->buf, writer->dict, writer->oldImage, 0, 0, width, height, delay, &pal);
 
-    return true;
+    return GifFlush(writer);
 }
 
-// Writes the EOF code, closes the file handle, and frees temp memory used by a GIF.
+// Writes the EOF code, closes the file handle (if GifBegin opened one), and frees temp memory used by a GIF.
 // Many if not most viewers will still display a GIF properly if the EOF code is missing,
 // but it's still a good idea to write it out.
 bool GifEnd( GifWriter* writer )
 {
-    if(!writer->f) return false;
+    if(!writer->write) return false;
 
-    fputc(0x3b, writer->f); // end of file
-    fclose(writer->f);
+    GifBufferPut(&writer->buf, 0x3b); // end of file
+    bool ok = GifFlush(writer);
+    if(writer->f && fclose(writer->f)) ok = false;
     GIF_FREE(writer->oldImage);
+    GIF_FREE(writer->tempImage);
+    GIF_FREE(writer->dict);
+    GifBufferFree(&writer->buf);
 
+    writer->write = NULL;
+    writer->user = NULL;
     writer->f = NULL;
     writer->oldImage = NULL;
+    writer->tempImage = NULL;
+    writer->dict = NULL;
 
-    return true;
+    return ok;
 }
 
 #endif
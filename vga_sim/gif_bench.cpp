@@ -0,0 +1,124 @@
+/*
+ * Microbenchmark for the gif.h per-pixel kernels over captured frames.
+ *
+ * Capture frames with:  obj_dir/V<top> --raw-out frames.raw   (Q to stop)
+ * then run:             make gif-bench   (GIF_BENCH_SIZE="1024 768" for --mode 3)
+ *
+ * A scale argument (GIF_BENCH_SCALE) also times the resample.hpp kernels
+ * and the encoder on frames downscaled by that factor.
+ *
+ * The same source is built with and without GIF_NO_SIMD/RESAMPLE_NO_SIMD;
+ * matching checksums show both paths produce the same bytes.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "gif.h"
+#include "resample.hpp"
+
+static uint64_t fnv1a(const uint8_t* p, size_t n, uint64_t h = 0xcbf29ce484222325)
+{
+	for (size_t i = 0; i < n; i++) h = (h ^ p[i]) * 0x100000001b3;
+	return h;
+}
+
+int main(int argc, char** argv)
+{
+	const char* raw = argc > 1 ? argv[1] : "frames.raw";
+	uint32_t w = argc > 2 ? atoi(argv[2]) : 640;
+	uint32_t h = argc > 3 ? atoi(argv[3]) : 480;
+	int scale = argc > 4 ? atoi(argv[4]) : 1;
+	size_t frame_bytes = (size_t)w * h * 4;
+
+	std::vector<std::vector<uint8_t>> frames;
+	FILE* f = fopen(raw, "rb");
+	if (!f) {
+		fprintf(stderr, "Usage: %s [frames.raw] [width] [height] [scale] (unable to open %s)\n", argv[0], raw);
+		return 1;
+	}
+	for (std::vector<uint8_t> b(frame_bytes); fread(b.data(), 1, frame_bytes, f) == frame_bytes; ) frames.push_back(b);
+	fclose(f);
+	if (frames.size() < 2) {
+		fprintf(stderr, "%s holds fewer than two %ux%u frames\n", raw, w, h);
+		return 1;
+	}
+
+	using clock = std::chrono::steady_clock;
+	double pick_ns = 0, threshold_ns = 0, frame_ns = 0;
+	uint64_t pick_sum = 0, threshold_sum = 0;
+	std::vector<uint8_t> scratch(frame_bytes), out(frame_bytes);
+
+	for (size_t i = 1; i < frames.size(); i++) {
+		const uint8_t* last = frames[i - 1].data();
+		const uint8_t* next = frames[i].data();
+
+		memcpy(scratch.data(), next, frame_bytes);
+		auto t0 = clock::now();
+		int changed = GifPickChangedPixels(last, scratch.data(), w * h);
+		pick_ns += std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+		pick_sum = fnv1a((const uint8_t*)&changed, sizeof(changed), fnv1a(scratch.data(), (size_t)changed * 4, pick_sum));
+
+		GifPalette pal;
+		GifMakePalette(last, next, w, h, 8, false, &pal, scratch.data());
+		t0 = clock::now();
+		GifThresholdImage(last, next, out.data(), w, h, &pal);
+		threshold_ns += std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+		threshold_sum = fnv1a(out.data(), frame_bytes, threshold_sum);
+	}
+
+	// whole encoder into memory, including palette building and LZW
+	GifBuffer mem = {};
+	GifWriter g;
+	GifBeginSink(&g, GifWriteMemory, &mem, w, h, 2);
+	for (auto& fr : frames) {
+		auto t0 = clock::now();
+		GifWriteFrame(&g, fr.data(), w, h, 2);
+		frame_ns += std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+	}
+	GifEnd(&g);
+
+	size_t n = frames.size() - 1;
+	double px = (double)w * h;
+#ifdef GIF_SIMD_WIDTH
+	printf("gif.h kernels, %d-wide SIMD, %zu %ux%u frames\n", GIF_SIMD_WIDTH, frames.size(), w, h);
+#else
+	printf("gif.h kernels, scalar, %zu %ux%u frames\n", frames.size(), w, h);
+#endif
+	printf("  GifPickChangedPixels %8.3f ms/frame %6.3f ns/px  sum %016lx\n", pick_ns / n / 1e6, pick_ns / n / px, pick_sum);
+	printf("  GifThresholdImage    %8.3f ms/frame %6.3f ns/px  sum %016lx\n", threshold_ns / n / 1e6, threshold_ns / n / px, threshold_sum);
+	printf("  GifWriteFrame        %8.3f ms/frame               sum %016lx\n", frame_ns / frames.size() / 1e6, fnv1a(mem.data, mem.size));
+	GifBufferFree(&mem);
+
+	if (scale < 2) return 0;
+	capture_region rg;
+	rg.scale = scale;
+	rg.fit(w, h);
+	std::vector<uint32_t> small((size_t)rg.out_w() * rg.out_h());
+	std::vector<uint16_t> acc;
+	for (int box = 1; box >= 0; box--) {
+		rg.box = box;
+		double resample_ns = 0, small_ns = 0;
+		uint64_t resample_sum = 0;
+		GifBuffer small_mem = {};
+		GifWriter sg;
+		GifBeginSink(&sg, GifWriteMemory, &small_mem, rg.out_w(), rg.out_h(), 2);
+		for (auto& fr : frames) {
+			auto t0 = clock::now();
+			resample(rg, (const uint32_t*)fr.data(), w, small.data(), acc);
+			resample_ns += std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+			resample_sum = fnv1a((const uint8_t*)small.data(), small.size() * 4, resample_sum);
+			t0 = clock::now();
+			GifWriteFrame(&sg, (const uint8_t*)small.data(), rg.out_w(), rg.out_h(), 2);
+			small_ns += std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+		}
+		GifEnd(&sg);
+		printf("  resample 1/%d %-7s %8.3f ms/frame %6.3f ns/px  sum %016lx\n", scale, box ? "box" : "nearest",
+			resample_ns / frames.size() / 1e6, resample_ns / frames.size() / px, resample_sum);
+		printf("  GifWriteFrame %ux%u %8.3f ms/frame (%.1fx cheaper), %zu bytes\n", rg.out_w(), rg.out_h(),
+			small_ns / frames.size() / 1e6, frame_ns / small_ns, small_mem.size);
+		GifBufferFree(&small_mem);
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "glyphs_rom.hpp" // generated from ../src/glyphs_rom.v by make
+
+/*
+ * Glyph-grid capture: each frame is stored as one 16-bit record per 8x12
+ * cell instead of pixels. Within a cell everything but the glyph bitmap is
+ * constant, so (glyph, color, on) reproduces the picture exactly:
+ *
+ *   pixel = on && glyph_rows[glyph][y % 12] bit (x % 8) ? color : 0
+ *
+ * File layout: glyph_capture_header, then per frame a glyph_frame_header
+ * followed by cols * rows cell records in raster order.
+ */
+
+enum { GLYPH_W = 8, GLYPH_H = 12 };
+constexpr int glyph_count = sizeof(glyph_rows) / GLYPH_H;
+
+struct glyph_capture_header {
+	char     magic[4];  // "TTGC"
+	uint16_t version;
+	uint16_t cols, rows;
+	uint16_t width, height;
+	uint16_t reserved;
+} __attribute__((packed));
+
+struct glyph_frame_header {
+	uint16_t frame;     // RTL frame counter
+	uint8_t  rst_drop;
+	uint8_t  ui_in;
+} __attribute__((packed));
+
+// Cell record: glyph [5:0], RRGGBB color [11:6], on [12]
+inline uint16_t glyph_cell(unsigned glyph, unsigned color, bool on) { return (glyph & 63) | (color & 63) << 6 | on << 12; }
+inline unsigned glyph_cell_glyph(uint16_t c) { return c & 63; }
+inline unsigned glyph_cell_color(uint16_t c) { return c >> 6 & 63; }
+inline bool     glyph_cell_on(uint16_t c)    { return c >> 12 & 1; }
+
+struct glyph_capture {
+	glyph_capture_header hdr = {};
+	glyph_frame_header   info = {};
+	std::vector<uint16_t> cells;
+	FILE* f = NULL;
+
+	bool open_write(const char* filename, int width, int height) {
+		if (!(f = fopen(filename, "wb"))) return false;
+		memcpy(hdr.magic, "TTGC", 4);
+		hdr.version = 1;
+		hdr.width = width;
+		hdr.height = height;
+		hdr.cols = width / GLYPH_W;
+		hdr.rows = height / GLYPH_H;
+		cells.assign(hdr.cols * hdr.rows, 0);
+		return fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	}
+
+	bool open_read(const char* filename) {
+		if (!(f = fopen(filename, "rb"))) return false;
+		if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, "TTGC", 4) || hdr.version != 1) {
+			close();
+			return false;
+		}
+		cells.assign(hdr.cols * hdr.rows, 0);
+		return true;
+	}
+
+	void close() { if (f) fclose(f); f = NULL; }
+
+	void set(int col, int row, uint16_t cell) {
+		if (col < hdr.cols && row < hdr.rows) cells[row * hdr.cols + col] = cell;
+	}
+
+	bool write_frame() {
+		return fwrite(&info, sizeof(info), 1, f) == 1 && fwrite(cells.data(), sizeof(uint16_t), cells.size(), f) == cells.size();
+	}
+
+	bool read_frame() {
+		return fread(&info, sizeof(info), 1, f) == 1 && fread(cells.data(), sizeof(uint16_t), cells.size(), f) == cells.size();
+	}
+
+	// Expands cell rows [row0, row0 + nrows) to 0x00RRGGBB pixels (ARGB8888) at out, stride in pixels
+	void render_rows(int row0, int nrows, uint32_t* out, int stride) const {
+		for (int row = row0; row < row0 + nrows && row < hdr.rows; row++) {
+			for (int gy = 0; gy < GLYPH_H; gy++) {
+				uint32_t* px = out + ((row - row0) * GLYPH_H + gy) * stride;
+				for (int col = 0; col < hdr.cols; col++, px += GLYPH_W) {
+					uint16_t c = cells[row * hdr.cols + col];
+					unsigned g = glyph_cell_glyph(c);
+					uint8_t bits = glyph_cell_on(c) ? glyph_rows[(g < glyph_count ? g : g - glyph_count) * GLYPH_H + gy] : 0;
+					unsigned rgb = glyph_cell_color(c);
+					uint32_t color = 85u * (rgb >> 4 & 3) << 16 | 85u * (rgb >> 2 & 3) << 8 | 85u * (rgb & 3);
+					for (int gx = 0; gx < GLYPH_W; gx++) px[gx] = (bits >> gx & 1) ? color : 0;
+				}
+			}
+		}
+	}
+
+	void render(uint32_t* out, int stride) const { render_rows(0, hdr.rows, out, stride); }
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+/*
+ * Input-to-photon latency of ui_in/rst_n changes.
+ *
+ * Each change is timestamped when the key event happened and followed
+ * through three points: when the loop applies it to the model (inputs are
+ * sampled once per frame, or per progressive slice), when the first active
+ * pixel is decoded after that, and when a present includes that pixel.
+ * Latencies are reported per VGA mode (ui_in[7:6] after the change); the
+ * p99 needs a few hundred key presses to mean much.
+ */
+struct latency_probe {
+	using clock = std::chrono::steady_clock;
+
+	struct event {
+		int mode;
+		clock::time_point input;  // key event
+		double sample_ms = 0;     // input -> applied to the model
+		double pixel_ms = -1;     // input -> first active pixel decoded
+		double present_ms = -1;   // input -> presented
+		int line = 0;             // scanline of that pixel
+	};
+
+	std::vector<event> pending, done;
+
+	static double ms(clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); }
+
+	// inputs changed at time when, being applied now
+	void input(clock::time_point when, int mode) {
+		event e;
+		e.mode = mode;
+		e.input = when;
+		e.sample_ms = ms(when, clock::now());
+		pending.push_back(e);
+	}
+
+	bool waiting_pixel() const { return !pending.empty() && pending.back().pixel_ms < 0; }
+
+	// an active pixel on line was just decoded (or a whole frame replayed, line 0)
+	void pixel(int line) {
+		auto now = clock::now();
+		for (auto& e : pending) if (e.pixel_ms < 0) { e.pixel_ms = ms(e.input, now); e.line = line; }
+	}
+
+	// the texture was presented up to beam (-1 for the whole frame)
+	void presented(int beam) {
+		auto now = clock::now();
+		for (size_t i = 0; i < pending.size(); ) {
+			event& e = pending[i];
+			if (e.pixel_ms >= 0 && (beam < 0 || e.line < beam)) {
+				e.present_ms = ms(e.input, now);
+				done.push_back(e);
+				pending.erase(pending.begin() + i);
+			} else i++;
+		}
+	}
+
+	static double percentile(std::vector<double>& v, double p) {
+		if (v.empty()) return 0;
+		size_t k = std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5));
+		std::nth_element(v.begin(), v.begin() + k, v.end());
+		return v[k];
+	}
+
+	// one line per RTL mode, on a width x height host mode
+	void report(int width, int height) const {
+		std::map<int, std::vector<const event*>> by_mode;
+		for (auto& e : done) by_mode[e.mode].push_back(&e);
+		for (auto& [mode, evs] : by_mode) {
+			std::vector<double> sample, pixel, present;
+			for (auto* e : evs) {
+				sample.push_back(e->sample_ms);
+				pixel.push_back(e->pixel_ms);
+				present.push_back(e->present_ms);
+			}
+			fprintf(stderr, "Input latency mode %d at %dx%d, %zu changes (ms p50/p99): sampled %.1f/%.1f, first pixel %.1f/%.1f, presented %.1f/%.1f\n",
+				mode, width, height, evs.size(), percentile(sample, .5), percentile(sample, .99), percentile(pixel, .5), percentile(pixel, .99),
+				percentile(present, .5), percentile(present, .99));
+		}
+	}
+
+	bool write_csv(const char* filename) const {
+		FILE* f = fopen(filename, "w");
+		if (!f) return false;
+		fprintf(f, "mode,sampled_ms,pixel_ms,presented_ms,line\n");
+		for (auto& e : done) fprintf(f, "%d,%.3f,%.3f,%.3f,%d\n", e.mode, e.sample_ms, e.pixel_ms, e.present_ms, e.line);
+		return fclose(f) == 0;
+	}
+};
@@ -1,25 +1,132 @@
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <vector>
 #include <cstdint>
 #include <SDL2/SDL.h>
 #include "verilated.h"
+#if VM_TRACE
+#include "verilated_fst_c.h"
+#endif
+#if VM_ACTIVITY
+#include "verilated_syms.h"
+#endif
 #include "vga_timings.hpp"
-#include "gif.h"
-
-struct ARGB8888_t { uint8_t b, g, r, a; } __attribute__((packed));
-union VGApinout_t {
-	uint8_t pins;
-	struct { // 6-bit color with sync
-		uint8_t r1 :1; uint8_t g1 :1; uint8_t b1 :1; uint8_t vsync :1;
-		uint8_t r0 :1; uint8_t g0 :1; uint8_t b0 :1; uint8_t hsync :1;
-	} __attribute__((packed));
+#include "vga_decode.hpp"
+#include "vga_clock.hpp"
+#include "pin_stream.hpp"
+#include "vga_pacer.hpp"
+#include "trace_window.hpp"
+#include "glyph_capture.hpp"
+#include "activity_profile.hpp"
+#include "frame_cache.hpp"
+#include "frame_sink.hpp"
+#include "web_view.hpp"
+#include "latency_probe.hpp"
+
+// internal RTL signals made public by vga_sim.vlt
+#define RTL(signal) top->rootp->tt_um_vga_glyph_mode__DOT__##signal
+
+// Mirrors the newest frame of a batch into the texture shadow, marking changed scanlines for upload
+struct sdl_sink : frame_sink {
+	std::vector<ARGB8888_t>& fb;
+	std::vector<bool>& dirty;
+	int width;
+
+	sdl_sink(std::vector<ARGB8888_t>& shadow, std::vector<bool>& dirty_lines, int w) : frame_sink("sdl"), fb(shadow), dirty(dirty_lines), width(w) {}
+
+	void mirror(const ARGB8888_t* src, int y0, int y1) {
+		for (int y = y0; y < y1; y++) {
+			if (memcmp(&fb[y * width], &src[y * width], width * sizeof(ARGB8888_t))) {
+				memcpy(&fb[y * width], &src[y * width], width * sizeof(ARGB8888_t));
+				dirty[y] = true;
+			}
+		}
+	}
+	void write(const frame_batch& batch) override { mirror(batch.back().pixels.data(), 0, dirty.size()); }
 };
 
+// Runs the two-phase and single-eval clocking side by side on scripted inputs, comparing uo_out every cycle
+static int clock_check(uint64_t frames, const vga_timing& vga)
+{
+	TOP_MODULE* ref = new TOP_MODULE;
+	TOP_MODULE* fast = new TOP_MODULE;
+	vga_clock<TOP_MODULE> ref_clock(ref), fast_clock(fast);
+	if (!fast_clock.single_available()) {
+		fprintf(stderr, "Single-eval clocking is not available with this Verilator version\n");
+		return 1;
+	}
+
+	// inputs change mid-frame: palette every 61 frames, mode every 389, reset held for a frame every 257
+	uint64_t frame_cycles = vga.frame_cycles(), mismatches = 0;
+	double ref_s = 0, fast_s = 0;
+	uint32_t lcg = 1;
+	uint8_t ui_in = 0;
+	for (uint64_t frame = 0; frame < frames && !mismatches; frame++) {
+		lcg = lcg * 1664525 + 1013904223;
+		uint64_t change_at = lcg % frame_cycles;
+		uint8_t next_ui_in = ui_in;
+		if (frame % 61 == 60) next_ui_in = (next_ui_in & ~3) | (lcg >> 16 & 3);
+		if (frame % 389 == 388) next_ui_in ^= 1 << 6;
+		bool reset = frame == 0 || frame % 257 == 256;
+
+		std::vector<uint8_t> out(frame_cycles);
+		auto t0 = std::chrono::steady_clock::now();
+		for (uint64_t c = 0; c < frame_cycles; c++) {
+			ref_clock.two_phase(reset, c < change_at ? ui_in : next_ui_in);
+			out[c] = ref->uo_out;
+		}
+		auto t1 = std::chrono::steady_clock::now();
+		for (uint64_t c = 0; c < frame_cycles; c++) {
+			fast_clock.single(reset, c < change_at ? ui_in : next_ui_in);
+			if (fast->uo_out != out[c] && !mismatches++)
+				fprintf(stderr, "Mismatch at frame %lu cycle %lu: uo_out %02x, two-phase %02x\n", frame, c, fast->uo_out, out[c]);
+		}
+		auto t2 = std::chrono::steady_clock::now();
+		ref_s += std::chrono::duration<double>(t1 - t0).count();
+		fast_s += std::chrono::duration<double>(t2 - t1).count();
+		ui_in = next_ui_in;
+
+		TOP_MODULE* top = ref;
+		uint16_t ref_frame = RTL(frame), ref_drop = RTL(rst_drop);
+		top = fast;
+		if (!mismatches && (RTL(frame) != ref_frame || RTL(rst_drop) != ref_drop)) {
+			fprintf(stderr, "Mismatch after frame %lu: frame %u rst_drop %u, two-phase %u %u\n", frame, RTL(frame), RTL(rst_drop), ref_frame, ref_drop);
+			mismatches++;
+		}
+		if (frame % 256 == 255) fprintf(stderr, "Checked %lu frames\r", frame + 1);
+	}
+
+	uint64_t cycles = frames * frame_cycles;
+	fprintf(stderr, "Clock check %s over %lu frames: two-phase %.2f Mcycles/s, single-eval %.2f Mcycles/s (%.2fx)\n",
+		mismatches ? "FAILED" : "passed", frames, cycles / ref_s / 1e6, cycles / fast_s / 1e6, ref_s / fast_s);
+	ref->final();
+	fast->final();
+	delete ref;
+	delete fast;
+	return mismatches ? 1 : 0;
+}
+
 int main(int argc, char **argv)
 {
 	static Uint32 fullscreen = 0; // Defaul command line options
-	bool polarity = false, slow = false, gif = false;
-	int gif_frames = 0;
+	bool polarity = false, slow = false, gif = false, full_upload = false, zero_copy = false, realtime = false, beam_internal = false;
+	int gif_frames = 0, progressive = 0, cache_mib = 0, sink_batch = 1, web_port = 0, web_fps = 30;
+	bool headless = false, latency_on = false;
+	const char* latency_file = NULL; // per-change input latencies
+	uint64_t clock_check_frames = 0;
+	std::vector<const char*> sink_specs; // --sink name[:arg], stackable
+	capture_region capture; // crop and downscale for GIF and raw captures
+	const char* gif_out = "output.gif"; // file, "-" for stdout or "mem" to hash in memory
+	const char* raw_file = NULL; // raw frame capture
+	const char* cells_out_file = NULL, *cells_in_file = NULL; // glyph-grid capture and playback
+	const char* pins_file = NULL; // raw uo_out stream for pins_decode
+	bool pins_rle = false, pins_only = false;
+	const char* trace_file = NULL; // windowed FST trace
+	vga_pos trace_start, trace_stop;
+	uint64_t trace_cycles = 0, trace_pre = 0;
+	bool trace_on_input = false;
+	const char* activity_file = NULL, *activity_frames_file = NULL; // switching-activity report
 	std::vector<vga_format> modes{VGA_640_480_60, VGA_768_576_60, VGA_800_600_60, VGA_1024_768_60};
 	vga_timing mode = vga_timings[modes[0]];
 
@@ -29,11 +136,72 @@ int main(int argc, char **argv)
 		else if (!strcmp("--fullscreen", p)) fullscreen = fullscreen ? 0 : SDL_WINDOW_FULLSCREEN_DESKTOP;
 		else if (!strcmp("--polarity", p)) polarity = !polarity;
 		else if (!strcmp("--slow", p)) slow = !slow;
+		else if (!strcmp("--realtime", p)) realtime = !realtime;
+		else if (!strcmp("--full-upload", p)) full_upload = !full_upload;
+		else if (!strcmp("--zero-copy", p)) zero_copy = !zero_copy;
+		else if (!strcmp("--beam-internal", p)) beam_internal = !beam_internal;
 		else if (!strcmp("--mode", p)) {
 			if (i + 1 < argc) {
 				int m = atoi(argv[++i]);
 				if (m >= 0 && m < modes.size()) mode = vga_timings[modes[m]];
 			}
+		} else if (!strcmp("--progressive", p)) {
+			if (i + 1 < argc) progressive = std::max(0, atoi(argv[++i]));
+		} else if (!strcmp("--frame-cache", p)) {
+			if (i + 1 < argc) cache_mib = std::max(0, atoi(argv[++i]));
+		} else if (!strcmp("--sink", p)) {
+			if (i + 1 < argc) sink_specs.push_back(argv[++i]);
+		} else if (!strcmp("--sink-batch", p)) {
+			if (i + 1 < argc) sink_batch = std::max(1, atoi(argv[++i]));
+		} else if (!strcmp("--web", p)) {
+			if (i + 1 < argc) web_port = atoi(argv[++i]);
+		} else if (!strcmp("--web-fps", p)) {
+			if (i + 1 < argc) web_fps = std::max(0, atoi(argv[++i]));
+		} else if (!strcmp("--clock-check", p)) {
+			if (i + 1 < argc) clock_check_frames = strtoull(argv[++i], NULL, 10);
+		} else if (!strcmp("--headless", p)) {
+			headless = !headless;
+		} else if (!strcmp("--latency", p)) {
+			latency_on = !latency_on;
+		} else if (!strcmp("--latency-out", p)) {
+			if (i + 1 < argc) latency_file = argv[++i];
+		} else if (!strcmp("--capture-crop", p)) {
+			if (i + 1 < argc && !capture.parse_crop(argv[++i])) fprintf(stderr, "Ignoring bad --capture-crop %s\n", argv[i]);
+		} else if (!strcmp("--capture-scale", p)) {
+			if (i + 1 < argc && !capture.parse_scale(argv[++i])) {
+				fprintf(stderr, "Ignoring bad --capture-scale %s\n", argv[i]);
+				capture.scale = 1;
+			}
+		} else if (!strcmp("--gif-out", p)) {
+			if (i + 1 < argc) gif_out = argv[++i];
+		} else if (!strcmp("--raw-out", p)) {
+			if (i + 1 < argc) raw_file = argv[++i];
+		} else if (!strcmp("--cells-out", p)) {
+			if (i + 1 < argc) cells_out_file = argv[++i];
+		} else if (!strcmp("--cells-in", p)) {
+			if (i + 1 < argc) cells_in_file = argv[++i];
+		} else if (!strcmp("--pins-out", p)) {
+			if (i + 1 < argc) pins_file = argv[++i];
+		} else if (!strcmp("--pins-rle", p)) {
+			pins_rle = !pins_rle;
+		} else if (!strcmp("--pins-only", p)) {
+			pins_only = !pins_only;
+		} else if (!strcmp("--trace", p)) {
+			if (i + 1 < argc) trace_file = argv[++i];
+		} else if (!strcmp("--trace-start", p)) {
+			if (i + 1 < argc && !trace_start.parse(argv[++i])) fprintf(stderr, "Ignoring bad --trace-start %s\n", argv[i]);
+		} else if (!strcmp("--trace-stop", p)) {
+			if (i + 1 < argc && !trace_stop.parse(argv[++i])) fprintf(stderr, "Ignoring bad --trace-stop %s\n", argv[i]);
+		} else if (!strcmp("--trace-cycles", p)) {
+			if (i + 1 < argc) trace_cycles = strtoull(argv[++i], NULL, 10);
+		} else if (!strcmp("--trace-pre", p)) {
+			if (i + 1 < argc) trace_pre = strtoull(argv[++i], NULL, 10);
+		} else if (!strcmp("--trace-on-input", p)) {
+			trace_on_input = !trace_on_input;
+		} else if (!strcmp("--activity", p)) {
+			if (i + 1 < argc) activity_file = argv[++i];
+		} else if (!strcmp("--activity-frames", p)) {
+			if (i + 1 < argc) activity_frames_file = argv[++i];
 		} else if (!strcmp("--gif", p)) {
 			gif = !gif;
 			if (i + 1 < argc) gif_frames = atoi(argv[++i]);
@@ -42,20 +210,137 @@ int main(int argc, char **argv)
 			printf("  --fullscreen   | [ F ]\tToggles SDL window size (default: %s)\n", fullscreen ? "maximized" : "minimized");
 			printf("  --polarity     | [ P ]\tToggles the VGA polarity sync high/low (default: %s)\n", polarity ? "true" : "false");
 			printf("  --slow         | [ S ]\tToggles the displayed frame rate (default: %s)\n", slow ? "true" : "false");
+			printf("  --realtime            \tToggles pacing to the VGA refresh rate, dropping/repeating frames (default: %s)\n", realtime ? "true" : "false");
+			printf("  --full-upload         \tToggles uploading the whole frame instead of changed lines (default: %s)\n", full_upload ? "true" : "false");
+			printf("  --zero-copy           \tToggles decoding straight into the locked SDL texture (default: %s)\n", zero_copy ? "true" : "false");
+			printf("  --beam-internal       \tToggles placing pixels at the RTL hpos/vpos instead of decoding the sync pins (default: %s)\n", beam_internal ? "true" : "false");
+			printf("  --clock-check [#]     \tCompares single-eval against two-phase clocking over # frames and exits\n");
 			printf("  --mode [#]            \tSets SDL VGA timing mode (value: [0:%ld])\n", modes.size()-1);
+			printf("  --progressive [#lines]\tPresents partial frames every # scanlines (default: %d)\n", progressive);
+			printf("  --frame-cache [MiB]   \tReplays frames seen before from a compressed cache of # MiB (default: %d)\n", cache_mib);
 			printf("  --gif [#frames]       \tSaves animated GIF (default: %s [%d])\n", gif ? "true" : "false", gif_frames);
+			printf("  --gif-out [file|-|mem]\tGIF destination, stdout or in-memory hash (default: %s)\n", gif_out);
+			printf("  --raw-out [file]      \tAppends each frame's 32-bit pixels to file (for make gif-bench)\n");
+			printf("  --capture-crop [x,y[,w,h]]\tCrops GIF and raw captures to a region (default: whole frame)\n");
+			printf("  --capture-scale [#[:box|nearest]]\tDownscales GIF and raw captures by # (default: 1, box)\n");
+			printf("  --sink [name[:arg]]   \tAdds a frame output: sdl, gif[:file|-|mem], raw:file, hash or null (default: sdl)\n");
+			printf("  --web [port]          \tServes a live view on http://localhost:port, keys work as in the window\n");
+			printf("  --web-fps [#]         \tCaps the frames per second sent to the live view, 0 for none (default: %d)\n", web_fps);
+			printf("  --headless            \tToggles running without a window, implies no sdl sink (default: %s)\n", headless ? "true" : "false");
+			printf("  --latency             \tToggles measuring input-to-photon latency per RTL mode (default: %s)\n", latency_on ? "true" : "false");
+			printf("  --latency-out [file.csv]\tAlso writes every input change's latencies, implies --latency\n");
+			printf("  --sink-batch [#]      \tDelivers frames to the sinks # at a time (default: %d)\n", sink_batch);
+			printf("  --cells-out [file]    \tCaptures frames as glyph-grid cell records\n");
+			printf("  --cells-in [file]     \tPlays back a glyph-grid capture instead of simulating\n");
+			printf("  --pins-out [file]     \tRecords the raw uo_out pins every clock (decode with pins_decode)\n");
+			printf("  --pins-rle            \tToggles run-length encoding the pin stream (default: %s)\n", pins_rle ? "true" : "false");
+			printf("  --pins-only           \tToggles skipping the inline decode while recording pins (default: %s)\n", pins_only ? "true" : "false");
+			printf("  --trace [file.fst]    \tWrites a windowed FST trace (needs make TRACE=1)\n");
+			printf("  --trace-start [f:l:p] \tOpens the trace window at frame:line:pixel (default: frame 0)\n");
+			printf("  --trace-stop [f:l:p]  \tCloses the trace window at frame:line:pixel\n");
+			printf("  --trace-cycles [#]    \tCloses the trace window after # cycles (default: one frame)\n");
+			printf("  --trace-on-input      \tToggles opening the trace window when ui_in changes (default: %s)\n", trace_on_input ? "true" : "false");
+			printf("  --trace-pre [#]       \tKeeps # cycles of pin history before the trigger (default: %lu)\n", trace_pre);
+			printf("  --activity [file.csv] \tWrites per-signal toggle counts ranked per mode (needs make ACTIVITY=1)\n");
+			printf("  --activity-frames [file.csv]\tAlso writes every frame's toggle counts\n");
 			printf("                 | [ Q ]\tQuits/Escapes (stops GIF if enabled).\n");
 			return 1;
 		}
 	}
 
+	glyph_capture cells_in, cells_out;
+	if (cells_in_file) { // playback picks the mode matching the capture
+		if (!cells_in.open_read(cells_in_file)) {
+			fprintf(stderr, "Unable to read glyph capture %s\n", cells_in_file);
+			return 1;
+		}
+		auto m = std::find_if(modes.begin(), modes.end(), [&](vga_format f) {
+			return vga_timings[f].h_active_pixels == cells_in.hdr.width && vga_timings[f].v_active_lines == cells_in.hdr.height;
+		});
+		if (m == modes.end()) {
+			fprintf(stderr, "No VGA mode matches the %ux%u glyph capture\n", cells_in.hdr.width, cells_in.hdr.height);
+			return 1;
+		}
+		mode = vga_timings[*m];
+	}
+
 	vga_timing vga = mode; // Select the VGA timings from the list
-	std::vector<ARGB8888_t> fb(vga.h_active_pixels * vga.v_active_lines);
+	if (clock_check_frames) {
+		Verilated::commandArgs(argc, argv);
+		return clock_check(clock_check_frames, vga);
+	}
+	if (cells_out_file && !cells_out.open_write(cells_out_file, vga.h_active_pixels, vga.v_active_lines)) {
+		fprintf(stderr, "Unable to write glyph capture %s\n", cells_out_file);
+		return 1;
+	}
+	std::vector<ARGB8888_t> fb(vga.h_active_pixels * vga.v_active_lines); // texture contents, kept by the sdl sink
+	std::vector<bool> dirty(vga.v_active_lines, true); // scanlines changed since the last upload
+	const int pitch = vga.h_active_pixels * sizeof(ARGB8888_t);
+	uint64_t upload_bytes = 0, upload_total = 0, upload_frames = 0;
 
-	GifWriter g; // GIF output
+	// frame outputs: --gif and --raw-out add their sinks to those named by --sink
+	frame_pipeline sinks;
+	sinks.batch_size = sink_batch;
+	sdl_sink* sdl = NULL;
 	int delay = ceilf(vga.frame_cycles() / (vga.clock_mhz * 10000.f)); // 100ths of a second
-	if (gif) GifBegin(&g, "output.gif", vga.h_active_pixels, vga.v_active_lines, delay);
+	if (!capture.fit(vga.h_active_pixels, vga.v_active_lines)) {
+		fprintf(stderr, "--capture-crop %d,%d is outside the %ux%u frame\n", capture.x, capture.y, vga.h_active_pixels, vga.v_active_lines);
+		return 1;
+	}
+	auto add_capture = [&](frame_sink* sink) { // captures go through the crop and downscale
+		if (capture.identity(vga.h_active_pixels, vga.v_active_lines)) sinks.add(sink);
+		else sinks.add(new resample_sink(sink, capture, vga.h_active_pixels));
+	};
+	auto add_gif = [&](const char* out) {
+		gif_sink* sink = new gif_sink;
+		add_capture(sink);
+		if (sink->open(out, capture.out_w(), capture.out_h(), delay)) return true;
+		fprintf(stderr, "Unable to write GIF to %s\n", out);
+		return false;
+	};
+	auto add_raw = [&](const char* out) {
+		raw_sink* sink = new raw_sink;
+		add_capture(sink);
+		if (sink->open(out)) return true;
+		fprintf(stderr, "Unable to write raw frames to %s\n", out);
+		return false;
+	};
+	if (sink_specs.empty() && !headless) sinks.add(sdl = new sdl_sink(fb, dirty, vga.h_active_pixels));
+	if (gif && !add_gif(gif_out)) return 1;
+	if (raw_file && !add_raw(raw_file)) return 1;
+	for (const char* spec : sink_specs) {
+		std::string name = spec;
+		const char* arg = strchr(spec, ':');
+		if (arg) name.resize(arg++ - spec);
+		if (name == "sdl" && !sdl) sinks.add(sdl = new sdl_sink(fb, dirty, vga.h_active_pixels));
+		else if (name == "gif") { if (!add_gif(arg ? arg : gif_out)) return 1; }
+		else if (name == "raw" && arg) { if (!add_raw(arg)) return 1; }
+		else if (name == "web" && arg) web_port = atoi(arg);
+		else if (name == "hash") sinks.add(new hash_sink);
+		else if (name == "null") sinks.add(new null_sink);
+		else {
+			fprintf(stderr, "Unknown --sink %s (sdl, gif[:file|-|mem], raw:file, web:port, hash or null)\n", spec);
+			return 1;
+		}
+	}
+	web_sink* web = NULL;
+	if (web_port) {
+		sinks.add(web = new web_sink(vga.h_active_pixels, vga.v_active_lines, web_fps));
+		if (!web->listen(web_port)) {
+			fprintf(stderr, "Unable to serve the live view on port %d\n", web_port);
+			return 1;
+		}
+		fprintf(stderr, "Live view on http://localhost:%d/\n", web_port);
+	}
+
+	pin_stream_writer pins_out;
+	if (pins_file && !pins_out.open(pins_file, vga, pins_rle)) {
+		fprintf(stderr, "Unable to write pin stream %s\n", pins_file);
+		return 1;
+	}
+	if (pins_only && !pins_out.f) pins_only = false;
 
+	if (headless) setenv("SDL_VIDEODRIVER", "dummy", 1); // no display, input comes from the live view
 	SDL_Init(SDL_INIT_VIDEO); // Initialize SDL2
 	SDL_Window* w = SDL_CreateWindow("Tiny Tapeout VGA", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, vga.h_active_pixels, vga.v_active_lines, SDL_WINDOW_RESIZABLE | fullscreen);
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "best");
@@ -63,15 +348,93 @@ int main(int argc, char **argv)
 	SDL_RenderSetLogicalSize(r, vga.h_active_pixels, vga.v_active_lines);
 	SDL_Texture* t = SDL_CreateTexture(r, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, vga.h_active_pixels, vga.v_active_lines);
 
+	// replayed frames skip the simulation, so nothing may need every cycle
+	frame_cache cache((size_t)cache_mib << 20);
+	if (cache.enabled() && (pins_file || cells_out_file || cells_in_file || trace_file || activity_file)) {
+		fprintf(stderr, "--frame-cache is not supported with --pins-out, --cells-out, --cells-in, --trace or --activity, disabled\n");
+		cache.budget = 0;
+	}
+
+	// zero-copy needs a streaming texture and no other reader of the framebuffer
+	if (zero_copy && (!sdl || sinks.sinks.size() > 1 || sink_batch > 1 || cells_in_file || cache.enabled())) {
+		fprintf(stderr, "--zero-copy needs the sdl sink alone, unbatched and without --cells-in or --frame-cache, using the framebuffer\n");
+		zero_copy = false;
+	}
+	if (progressive && !sdl) progressive = 0;
+	if (zero_copy && progressive) {
+		fprintf(stderr, "--zero-copy is not supported with --progressive, using the framebuffer\n");
+		zero_copy = false;
+	}
+	if (zero_copy) {
+		void* pixels;
+		int tex_pitch;
+		if (!t || SDL_LockTexture(t, NULL, &pixels, &tex_pitch) < 0) {
+			fprintf(stderr, "SDL_LockTexture failed (%s), using the framebuffer\n", SDL_GetError());
+			zero_copy = false;
+		} else {
+			for (int y = 0; y < vga.v_active_lines; y++) memset((uint8_t*)pixels + y * tex_pitch, 0, pitch);
+			SDL_UnlockTexture(t);
+		}
+	}
+
 	Verilated::commandArgs(argc, argv);
+#if VM_TRACE
+	if (trace_file) Verilated::traceEverOn(true);
+#endif
 	TOP_MODULE *top = new TOP_MODULE;
 
-	bool quit = false; // Main single frame loop
-	while (!quit && !Verilated::gotFinish()) {
-		int last_ticks = SDL_GetTicks();
-		static int frame = 0;
+	uint64_t cycles = 0; // total simulated cycles
+	double sim_seconds = 0; // time spent in the cycle loop
+#if VM_TRACE
+	trace_state trace = TRACE_OFF;
+	pin_history trace_history;
+	uint64_t trace_end = 0; // absolute cycle that closes the window
+	VerilatedFstC* tfp = NULL;
+	if (trace_file) {
+		tfp = new VerilatedFstC;
+		top->trace(tfp, 99);
+		trace = TRACE_ARMED;
+		if (!trace_start.valid() && !trace_on_input) trace_start.frame = 0;
+		trace_history.resize(trace_pre);
+	}
+#else
+	if (trace_file) fprintf(stderr, "--trace needs the model built with make TRACE=1, ignoring\n");
+	(void)trace_cycles; // only read by the trace window
+#endif
+
+	activity_profile activity;
+#if VM_ACTIVITY
+	if (activity_file) { // every public variable of every scope, except the clock
+		for (auto& [scope_name, scope] : *Verilated::threadContextp()->scopeNameMap()) {
+			if (!scope->varsp()) continue;
+			for (auto& [var_name, var] : *scope->varsp()) {
+				if (var.isParam() || !strcmp(var_name, "clk")) continue;
+				int width = var.packed().elements() * (var.totalSize() / var.entSize());
+				activity.add(std::string(scope_name) + "." + var_name, var.datap(), var.totalSize(), width);
+			}
+		}
+		if (activity_frames_file && !activity.open_frames(activity_frames_file)) {
+			fprintf(stderr, "Unable to write activity frames to %s\n", activity_frames_file);
+			return 1;
+		}
+		fprintf(stderr, "Profiling switching activity of %zu signals\n", activity.sigs.size());
+	}
+#else
+	if (activity_file) fprintf(stderr, "--activity needs the model built with make ACTIVITY=1, ignoring\n");
+	activity_file = NULL;
+	(void)activity_frames_file; // only read by the profiler
+#endif
+
+	bool quit = false;
+	bool rst_n = false, rst_init = false;
+	uint8_t ui_in = 0;
+	latency_probe latency;
+	if (latency_file) latency_on = true;
+	auto poll_input = [&]() { // SDL events and keyboard sampled inputs
 		SDL_Event e;
+		Uint32 key_ticks = 0; // first key event of this poll, dates an input change
 		while (SDL_PollEvent(&e)) {
+			if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && !key_ticks) key_ticks = e.key.timestamp;
 			if (e.type == SDL_QUIT) quit = true;
 			else if (e.type == SDL_KEYDOWN) {
 				switch (e.key.keysym.sym) {
@@ -95,10 +458,13 @@ int main(int argc, char **argv)
 		}
 
 		auto k = SDL_GetKeyboardState(NULL);
-		auto rst_n = k[SDL_SCANCODE_R];
-		static bool rst_init = false;
+		rst_n = k[SDL_SCANCODE_R];
+		if (web) {
+			web->poll();
+			rst_n |= web->rst();
+		}
 		if (!rst_init) { rst_n = rst_init = true; } // reset on first clock cycle
-		uint8_t ui_in = 0;
+		ui_in = 0;
 		ui_in |= k[SDL_SCANCODE_0] << 0;
 		ui_in |= k[SDL_SCANCODE_1] << 1;
 		ui_in |= k[SDL_SCANCODE_2] << 2;
@@ -107,67 +473,282 @@ int main(int argc, char **argv)
 		ui_in |= k[SDL_SCANCODE_5] << 5;
 		ui_in |= k[SDL_SCANCODE_6] << 6;
 		ui_in |= k[SDL_SCANCODE_7] << 7;
+		if (web) ui_in |= web->ui_in();
+
+		static uint8_t last_ui_in = 0;
+		static bool last_rst_n = true;
+		if (latency_on && (ui_in != last_ui_in || rst_n != last_rst_n)) { // web input carries no timestamp, dated now
+			auto when = latency_probe::clock::now();
+			if (key_ticks) when -= std::chrono::milliseconds(SDL_GetTicks() - key_ticks);
+			latency.input(when, ui_in >> 6);
+		}
+		last_ui_in = ui_in;
+		last_rst_n = rst_n;
+	};
+
+	auto upload = [&]() { // upload changed scanlines
+		if (zero_copy) {
+			SDL_UnlockTexture(t);
+			upload_bytes += (uint64_t)vga.v_active_lines * pitch;
+		} else {
+			for (int y = 0; y < vga.v_active_lines; y++) {
+				if (!dirty[y] && !full_upload) continue;
+				int y0 = y;
+				while (y < vga.v_active_lines && (dirty[y] || full_upload)) dirty[y++] = false;
+				SDL_Rect rect = { 0, y0, (int)vga.h_active_pixels, y - y0 };
+				SDL_UpdateTexture(t, &rect, &fb[y0 * vga.h_active_pixels], pitch);
+				upload_bytes += (uint64_t)rect.h * pitch;
+			}
+		}
+	};
+
+	auto show = [&](int beam) { // present the texture, marking the beam line
+		SDL_RenderClear(r);
+		SDL_RenderCopy(r, t, NULL, NULL);
+		if (beam >= 0) {
+			SDL_SetRenderDrawColor(r, 255, 0, 0, 255);
+			SDL_RenderDrawLine(r, 0, beam, vga.h_active_pixels - 1, beam);
+			SDL_SetRenderDrawColor(r, 0, 0, 0, 255);
+		}
+		SDL_RenderPresent(r);
+		if (latency_on) latency.presented(beam);
+	};
+
+	vga_pacer pacer(vga);
+	while (!quit && !Verilated::gotFinish()) { // Main single frame loop
+		int last_ticks = SDL_GetTicks();
+		static int frame = 0;
+		poll_input();
+		upload_bytes = 0;
+
+		// pixel destination: the locked texture when zero-copy, else a frame for the sinks
+		frame_t cur;
+		ARGB8888_t* pixels = NULL;
+		int stride = vga.h_active_pixels;
+		int progress_line = 0;
+		if (zero_copy) {
+			void* tex_pixels;
+			int tex_pitch;
+			if (SDL_LockTexture(t, NULL, &tex_pixels, &tex_pitch) < 0) { // e.g. a lost device or renderer reset
+				fprintf(stderr, "SDL_LockTexture failed (%s), using the framebuffer\n", SDL_GetError());
+				zero_copy = false;
+				dirty.assign(dirty.size(), true); // the texture no longer matches the shadow
+			} else {
+				pixels = (ARGB8888_t*)tex_pixels;
+				stride = tex_pitch / sizeof(ARGB8888_t);
+			}
+		}
+		if (!zero_copy) {
+			cur = sinks.take(fb.size());
+			cur.index = frame;
+			pixels = cur.pixels.data();
+		}
+
+		// glyph-grid playback replaces the simulation
+		uint64_t frame_cycles = vga.frame_cycles();
+		if (cells_in.f) {
+			if (!cells_in.read_frame()) break;
+			void* dst = pixels; // ARGB8888_t matches the 0x00RRGGBB words
+			cells_in.render((uint32_t*)dst, stride);
+			frame_cycles = 0;
+		}
+
+		// replay a frame drawn from the same animation state instead of simulating it
+		static unsigned anim_frame = 0; // RTL frame and rst_drop at the start of this frame
+		static bool anim_drop = false, model_stale = false;
+		uint32_t cache_key = frame_cache::key(anim_frame, anim_drop, ui_in, polarity, beam_internal);
+		uint8_t frame_ui_in = ui_in;
+		bool frame_polarity = polarity, replayed = false;
+		// the window must start at the RTL's beam origin: hvsync_generator keeps counting through a mode change,
+		// so after one the windows straddle two RTL frames at a phase the key does not capture
+		bool frame_aligned = RTL(hpos) == 0 && RTL(vpos) == 0;
+		if (cache.enabled() && frame > 0 && !rst_n && frame_aligned && cache.load(cache_key, pixels, cur.pixels.size())) {
+			frame_cycles = 0;
+			replayed = model_stale = true;
+			if (latency_on) latency.pixel(0); // the whole frame at once
+		} else if (model_stale) { // the model sat still while replaying, catch up its animation state
+			RTL(frame) = anim_frame;
+			RTL(rst_drop) = anim_drop;
+			model_stale = false;
+		}
+
+		// the animation state this frame is drawn with, vsync advances it before the frame ends
+		unsigned start_frame = RTL(frame);
+		bool start_drop = RTL(rst_drop);
+
+		static vga_decoder dec(vga);
+		auto sim_start = std::chrono::steady_clock::now();
+		for (uint64_t cycle = 0; cycle < frame_cycles; cycle++, cycles++) { // Intra-frame verilator cycles
+#if VM_TRACE
+			if (trace == TRACE_ARMED && (trace_start.reached(frame, dec.vnum, dec.hnum) || (trace_on_input && ui_in != top->ui_in))) {
+				std::string pre = std::string(trace_file) + ".pre.vcd";
+				if (trace_history.count && trace_history.write_vcd(pre.c_str(), 2 * cycles))
+					fprintf(stderr, "Trace pre-trigger history (%lu cycles) written to %s\n", trace_history.count, pre.c_str());
+				tfp->open(trace_file);
+				trace_end = trace_stop.valid() ? UINT64_MAX : cycles + (trace_cycles ? trace_cycles : vga.frame_cycles());
+				trace = TRACE_ACTIVE;
+				fprintf(stderr, "Trace started at frame %d line %d pixel %d (cycle %lu)\n", frame, dec.vnum, dec.hnum, cycles);
+			} else if (trace == TRACE_ACTIVE && (cycles >= trace_end || trace_stop.reached(frame, dec.vnum, dec.hnum))) {
+				tfp->close();
+				trace = TRACE_DONE;
+				fprintf(stderr, "Trace stopped at frame %d line %d pixel %d (cycle %lu), written to %s\n", frame, dec.vnum, dec.hnum, cycles, trace_file);
+			}
+#endif
 
-		static int hnum = 0;
-		static int vnum = 0;
-		for (int cycle = 0; cycle < vga.frame_cycles(); cycle++) { // Intra-frame verilator cycles
 			// set inputs and tick-tock
 			top->clk = 0;
 			top->eval();
+#if VM_TRACE
+			if (trace == TRACE_ACTIVE) tfp->dump(2 * cycles);
+#endif
 			if (rst_n) top->rst_n = 0;
 			top->ui_in = ui_in;
 			top->clk = 1;
 			top->eval();
+#if VM_TRACE
+			if (trace == TRACE_ACTIVE) tfp->dump(2 * cycles + 1);
+			else if (trace == TRACE_ARMED) trace_history.push(top->ui_in, top->rst_n, top->uo_out);
+#endif
 			if (rst_n) top->rst_n = 1;
 			top->ui_in = ui_in;
+			if (activity_file) activity.sample();
 
-			VGApinout_t uo_out{top->uo_out};
+			// sample each cell's glyph, color and visibility at its top-left pixel
+			if (cells_out.f && RTL(display_on) && !(RTL(hpos) & 7) && RTL(vpos) % GLYPH_H == 0)
+				cells_out.set(RTL(hpos) / GLYPH_W, RTL(vpos) / GLYPH_H, glyph_cell(RTL(glyph_index), RTL(z), !(RTL(f) || RTL(n) || RTL(drop_bit))));
 
-			// h and v blank/sync logic
-			if ((uo_out.hsync == vga.h_sync_pol) ^ polarity && (uo_out.vsync == vga.v_sync_pol) ^ polarity) {
-				hnum = -vga.h_back_porch;
-				vnum = -vga.v_back_porch;
+			// recording is a single store, decoding is left to pins_decode
+			if (pins_out.f) {
+				pins_out.pins[cycle] = top->uo_out;
+				if (pins_only) continue;
 			}
 
-			// active frame, scaling for 6-bit color
-			if ((hnum >= 0) && (hnum < vga.h_active_pixels) && (vnum >= 0) && (vnum < vga.v_active_lines)) {
-				uint8_t rr = 85 * (uo_out.r1 << 1 | uo_out.r0);
-				uint8_t gg = 85 * (uo_out.g1 << 1 | uo_out.g0);
-				uint8_t bb = 85 * (uo_out.b1 << 1 | uo_out.b0);
-				ARGB8888_t rgb = { .b = bb, .g = gg, .r = rr };
-				fb[vnum * vga.h_active_pixels + hnum] = rgb;
+			VGApinout_t uo_out{top->uo_out};
+			bool active, line_start;
+			if (beam_internal) { // the RTL beam position, no sync reconstruction
+				dec.hnum = RTL(hpos);
+				dec.vnum = RTL(vpos);
+				// display_on follows the RTL mode (ui_in[7:6]), which may be larger than the host --mode
+				bool in_frame = dec.hnum < vga.h_active_pixels && dec.vnum < vga.v_active_lines;
+				active = RTL(display_on) && in_frame;
+				line_start = dec.hnum == 0 && dec.vnum < vga.v_active_lines;
+			} else {
+				dec.sync(uo_out, polarity);
+				active = dec.active();
 			}
 
-			// keep track of encountered fields
-			hnum++;
-			if (hnum >= vga.h_active_pixels + vga.h_front_porch + vga.h_sync_pulse) {
-				hnum = -vga.h_back_porch;
-				vnum++;
+			// active frame
+			if (active) pixels[dec.vnum * stride + dec.hnum] = uo_out.argb(); // changed lines are found by the sdl sink
+			if (active && latency_on && latency.waiting_pixel()) latency.pixel(dec.vnum);
+
+			if (!beam_internal) line_start = dec.next();
+			if (line_start) {
+				// present the partial frame every progressive scanlines
+				if (progressive && dec.vnum > 0 && dec.vnum < vga.v_active_lines && dec.vnum % progressive == 0) {
+					sdl->mirror(pixels, progress_line, dec.vnum);
+					progress_line = dec.vnum;
+					upload();
+					show(dec.vnum);
+					poll_input();
+				}
 			}
 		}
+		sim_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - sim_start).count();
 
-		SDL_RenderClear(r);
-		SDL_UpdateTexture(t, NULL, fb.data(), vga.h_active_pixels * sizeof(ARGB8888_t));
-		SDL_RenderCopy(r, t, NULL, NULL);
-		SDL_RenderPresent(r);
+		if (cache.enabled()) {
+			if (replayed) { // advance as the RTL does on vsync
+				if (anim_frame == 1023) anim_drop = true;
+				anim_frame = (anim_frame + 1) & 1023;
+			} else {
+				// only cache frames drawn from one state throughout
+				bool clean = frame > 0 && !rst_n && frame_aligned && ui_in == frame_ui_in && polarity == frame_polarity
+					&& RTL(frame) == ((anim_frame + 1) & 1023) && RTL(rst_drop) == (anim_drop || anim_frame == 1023);
+				if (clean) cache.store(cache_key, pixels, cur.pixels.size());
+				anim_frame = RTL(frame);
+				anim_drop = RTL(rst_drop);
+			}
+		}
+
+		if (!zero_copy) sinks.submit(std::move(cur));
+
+		if (!realtime || pacer.frame_done()) {
+			upload();
+			show(-1);
+		} else if (zero_copy) {
+			upload(); // a dropped frame must still release the texture
+		}
+		upload_total += upload_bytes;
+		upload_frames++;
+
+		// ahead of the VGA refresh rate: keep the display refreshed until the next frame is due
+		while (realtime && pacer.ahead() > pacer.period) {
+			SDL_Delay(pacer.period * 1000);
+			show(-1);
+			pacer.repeated++;
+		}
+		if (realtime && pacer.ahead() > 0) SDL_Delay(pacer.ahead() * 1000);
+		else if (replayed && !realtime) { // replay at the VGA refresh rate rather than spinning
+			int wait = pacer.period * 1000 - (SDL_GetTicks() - last_ticks);
+			if (wait > 0) SDL_Delay(wait);
+		}
 
 		int ticks = SDL_GetTicks();
 		static int last_update_ticks = 0;
 		if (ticks - last_update_ticks > 500) {
 			last_update_ticks = ticks;
-			std::string fps = "Tiny Tapeout VGA (" + std::to_string((int)1000.0/(ticks - last_ticks)) + " FPS)";
+			std::string fps = "Tiny Tapeout VGA (" + std::to_string((int)1000.0/(ticks - last_ticks)) + " FPS, " + std::to_string(upload_bytes / 1024) + " KiB/frame";
+			if (realtime) {
+				char hz[64];
+				snprintf(hz, sizeof(hz), ", %.1f/%.1f Hz", pacer.achieved_hz(), pacer.target_hz());
+				fps += hz;
+			}
+			fps += ")";
 			SDL_SetWindowTitle(w, fps.c_str());
 		}
-		if (gif) {
-			GifWriteFrame(&g, (uint8_t*)fb.data(), vga.h_active_pixels, vga.v_active_lines, delay);
-			if (++frame == gif_frames) quit = true;
+		if (gif && frame + 1 == gif_frames) quit = true;
+		if (cells_out.f) {
+			cells_out.info = { (uint16_t)start_frame, start_drop, frame_ui_in };
+			cells_out.write_frame();
+		}
+		if (activity_file && frame_cycles) activity.end_frame(ui_in >> 6, frame, frame_cycles); // RTL mode from ui_in[7:6]
+		if (pins_out.f && frame_cycles && !pins_out.write_frame()) {
+			fprintf(stderr, "Error writing pin stream %s\n", pins_file);
+			pins_out.close();
 		}
+		frame++;
 		if (slow) usleep(250000); // ~4 fps
 
 	}
 
-	if (gif) GifEnd(&g);
+	sinks.finish();
+	if (realtime) fprintf(stderr, "Paced %lu frames at %.2f Hz (target %.2f Hz): %lu presented, %lu dropped, %lu repeated, %lu slipped\n",
+		pacer.frames, pacer.achieved_hz(), pacer.target_hz(), pacer.presented, pacer.dropped, pacer.repeated, pacer.slipped);
+	if (sim_seconds > 0) fprintf(stderr, "Simulated %lu cycles in %.3f s (%.2f Mcycles/s, %.1f frames/s), beam from %s\n",
+		cycles, sim_seconds, cycles / sim_seconds / 1e6, cycles / sim_seconds / vga.frame_cycles(),
+		pins_only ? "none (--pins-only)" : beam_internal ? "RTL hpos/vpos" : "sync pins");
+	if (cache.enabled()) fprintf(stderr, "Frame cache: %lu replayed, %lu simulated, %lu frames stored in %.1f MiB (%.1f KiB/frame), %lu over budget\n",
+		cache.hits, cache.misses, cache.stored, cache.bytes / 1048576.0, cache.stored ? cache.bytes / 1024.0 / cache.stored : 0.0, cache.skipped);
+	if (latency_on) {
+		latency.report(vga.h_active_pixels, vga.v_active_lines);
+		if (latency_file && !latency.write_csv(latency_file)) fprintf(stderr, "Unable to write latencies to %s\n", latency_file);
+	}
+	if (upload_frames) fprintf(stderr, "Uploaded %lu KiB over %lu frames (%lu KiB/frame)\n", upload_total / 1024, upload_frames, upload_total / upload_frames / 1024);
 
+	if (activity_file) {
+		if (activity.write_report(activity_file)) fprintf(stderr, "Switching activity of %zu signals written to %s\n", activity.sigs.size(), activity_file);
+		else fprintf(stderr, "Unable to write activity report %s\n", activity_file);
+		activity.close();
+	}
+	cells_out.close();
+	cells_in.close();
+	pins_out.close();
+#if VM_TRACE
+	if (trace == TRACE_ACTIVE) {
+		tfp->close();
+		fprintf(stderr, "Trace closed at exit, written to %s\n", trace_file);
+	}
+	delete tfp;
+#endif
 	top->final();
 	delete top;
 
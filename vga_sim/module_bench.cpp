@@ -0,0 +1,112 @@
+/*
+ * eval() cost of one RTL module on its own, to see which part of the
+ * design dominates simulation time.
+ *
+ * make module-bench verilates every module with itself as top and builds
+ * this harness once per module, BENCH_MODULE being its Verilator class and
+ * BENCH_<module> selecting the driver below. Inputs follow what the top
+ * level feeds each module across a whole VGA frame, blanking included:
+ *
+ *   glyphs_rom        x/y walk the 8x12 cell, c changes every cell
+ *   palette_rom       cid changes every cell, pid stays on one palette
+ *   hvsync_generator  clocked in the given mode after a reset
+ *   top level         clocked as vga_sim does, with ui_in selecting the mode
+ *
+ * The combinational inputs are generated up front so only the port writes
+ * and eval() are timed. The checksum of the outputs keeps the work from
+ * being optimised away and should stay put across RTL restructuring.
+ *
+ * Usage: bench_<module> [frames] [mode 0-3]
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "verilated.h"
+#include "vga_timings.hpp"
+
+#define BENCH_STR2(x) #x
+#define BENCH_STR(x) BENCH_STR2(x)
+
+int main(int argc, char** argv)
+{
+	uint64_t frames = argc > 1 ? strtoull(argv[1], NULL, 10) : 60;
+	int mode = argc > 2 ? atoi(argv[2]) & 3 : 0;
+	static const vga_format rtl_modes[] = {VGA_640_480_60, VGA_768_576_60, VGA_800_600_60, VGA_1024_768_60}; // ui_in[7:6]
+	const vga_timing& vga = vga_timings[rtl_modes[mode]];
+
+	BENCH_MODULE* m = new BENCH_MODULE;
+	uint64_t evals = 0, sum = 0;
+
+#if defined(BENCH_glyphs_rom) || defined(BENCH_palette_rom)
+	std::vector<uint16_t> in(vga.frame_cycles()); // one frame of packed port values
+	uint32_t h_total = vga.h_active_pixels + vga.h_front_porch + vga.h_sync_pulse + vga.h_back_porch;
+	uint32_t v_total = vga.frame_cycles() / h_total;
+	uint32_t lcg = 1;
+	std::vector<uint8_t> cells((h_total + 7) / 8);
+	for (uint32_t v = 0, i = 0; v < v_total; v++) {
+		if (v % 12 == 0) for (auto& c : cells) c = (lcg = lcg * 1103515245 + 12345) >> 16;
+		for (uint32_t h = 0; h < h_total; h++, i++) {
+#ifdef BENCH_glyphs_rom
+			in[i] = (cells[h / 8] & 63) << 7 | (v % 12) << 3 | (h & 7);
+#else
+			in[i] = (cells[h / 8] & 7) << 2; // palette 0
+#endif
+		}
+	}
+#endif
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (uint64_t f = 0; f < frames; f++) {
+#if defined(BENCH_glyphs_rom)
+		for (uint16_t x : in) {
+			m->c = x >> 7;
+			m->y = x >> 3 & 15;
+			m->x = x & 7;
+			m->eval();
+			sum += m->pixel;
+		}
+		evals += in.size();
+#elif defined(BENCH_palette_rom)
+		for (uint16_t x : in) {
+			m->cid = x >> 2;
+			m->pid = x & 3;
+			m->eval();
+			sum = sum * 31 + m->color;
+		}
+		evals += in.size();
+#elif defined(BENCH_hvsync_generator)
+		m->mode = mode;
+		for (uint64_t c = 0; c < vga.frame_cycles(); c++) {
+			m->reset = f == 0 && c == 0;
+			m->clk = 0;
+			m->eval();
+			m->clk = 1;
+			m->eval();
+			sum = sum * 31 + (m->hsync << 1 | m->vsync) + m->display_on;
+		}
+		evals += 2 * vga.frame_cycles();
+#else // the top level
+		m->ena = 1;
+		m->ui_in = mode << 6;
+		for (uint64_t c = 0; c < vga.frame_cycles(); c++) {
+			m->rst_n = !(f == 0 && c == 0);
+			m->clk = 0;
+			m->eval();
+			m->clk = 1;
+			m->eval();
+			sum = sum * 31 + m->uo_out;
+		}
+		evals += 2 * vga.frame_cycles();
+#endif
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	printf("%-22s mode %d, %lu frames: %lu evals, %.2f ns/eval, %.2f ns/pixel clock (checksum %016lx)\n",
+		BENCH_STR(BENCH_MODULE) + 1, mode, frames, evals, seconds * 1e9 / evals, seconds * 1e9 / (frames * vga.frame_cycles()), sum);
+	m->final();
+	delete m;
+	return 0;
+}
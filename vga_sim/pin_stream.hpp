@@ -0,0 +1,134 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "vga_timings.hpp"
+
+/*
+ * Raw uo_out pin stream: one byte per pixel clock, grouped in frames of
+ * frame_cycles() bytes as simulated by vga_sim. Decoding (sync polarity,
+ * colour, GIF) can then be redone offline without re-simulating.
+ *
+ * Uncompressed frames follow the header back to back. With PIN_STREAM_RLE
+ * each frame is a uint32 byte count followed by (pins, LEB128 run length)
+ * pairs, which collapses the long sync and blanking runs.
+ */
+
+enum { PIN_STREAM_RLE = 1 };
+
+struct pin_stream_header {
+	char       magic[4]; // "TTPS"
+	uint16_t   version;
+	uint16_t   flags;
+	vga_timing timing;
+	uint64_t   frame_cycles;
+} __attribute__((packed));
+
+struct pin_stream_writer {
+	pin_stream_header hdr = {};
+	std::vector<uint8_t> pins;  // current frame, one byte per cycle
+	std::vector<uint8_t> rle;
+	FILE* f = NULL;
+
+	bool open(const char* filename, const vga_timing& vga, bool compress) {
+		if (!(f = fopen(filename, "wb"))) return false;
+		memcpy(hdr.magic, "TTPS", 4);
+		hdr.version = 1;
+		hdr.flags = compress ? PIN_STREAM_RLE : 0;
+		hdr.timing = vga;
+		hdr.frame_cycles = vga.frame_cycles();
+		pins.assign(hdr.frame_cycles, 0);
+		return fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	}
+
+	void close() { if (f) fclose(f); f = NULL; }
+
+	bool write_frame() {
+		if (!(hdr.flags & PIN_STREAM_RLE)) return fwrite(pins.data(), 1, pins.size(), f) == pins.size();
+
+		rle.clear();
+		for (size_t i = 0; i < pins.size(); ) {
+			size_t j = i + 1;
+			while (j < pins.size() && pins[j] == pins[i]) j++;
+			rle.push_back(pins[i]);
+			for (uint64_t run = j - i; ; run >>= 7) {
+				rle.push_back((run & 0x7f) | (run > 0x7f ? 0x80 : 0));
+				if (run <= 0x7f) break;
+			}
+			i = j;
+		}
+		uint32_t size = rle.size();
+		return fwrite(&size, sizeof(size), 1, f) == 1 && fwrite(rle.data(), 1, rle.size(), f) == rle.size();
+	}
+};
+
+// Memory-mapped reader, frames can be expanded concurrently
+struct pin_stream_reader {
+	pin_stream_header hdr = {};
+	const uint8_t* data = NULL;
+	size_t size = 0;
+	std::vector<size_t> offsets;   // start of each frame's data
+	std::vector<uint32_t> lengths; // encoded length of each frame
+
+	bool open(const char* filename) {
+		int fd = ::open(filename, O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) || (size_t)st.st_size < sizeof(hdr)) { ::close(fd); return false; }
+		size = st.st_size;
+		void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (p == MAP_FAILED) return false;
+		data = (const uint8_t*)p;
+		madvise(p, size, MADV_SEQUENTIAL);
+
+		memcpy(&hdr, data, sizeof(hdr));
+		if (memcmp(hdr.magic, "TTPS", 4) || hdr.version != 1 || !hdr.frame_cycles) { close(); return false; }
+
+		// index the frames, only the RLE block headers are touched
+		for (size_t off = sizeof(hdr); off < size; ) {
+			uint32_t len = hdr.frame_cycles;
+			if (hdr.flags & PIN_STREAM_RLE) {
+				if (off + sizeof(len) > size) break;
+				memcpy(&len, data + off, sizeof(len));
+				off += sizeof(len);
+			}
+			if (off + len > size) break; // truncated frame
+			offsets.push_back(off);
+			lengths.push_back(len);
+			off += len;
+		}
+		return true;
+	}
+
+	void close() { if (data) munmap((void*)data, size); data = NULL; }
+
+	size_t frames() const { return offsets.size(); }
+
+	// Expands frame i into out (frame_cycles bytes)
+	bool expand(size_t i, uint8_t* out) const {
+		const uint8_t* p = data + offsets[i];
+		if (!(hdr.flags & PIN_STREAM_RLE)) { memcpy(out, p, hdr.frame_cycles); return true; }
+
+		const uint8_t* end = p + lengths[i];
+		uint64_t n = 0;
+		while (p < end) {
+			uint8_t pins = *p++;
+			uint64_t run = 0;
+			for (int shift = 0; p < end; shift += 7) {
+				uint8_t b = *p++;
+				run |= (uint64_t)(b & 0x7f) << shift;
+				if (!(b & 0x80)) break;
+			}
+			if (n + run > hdr.frame_cycles) return false;
+			memset(out + n, pins, run);
+			n += run;
+		}
+		return n == hdr.frame_cycles;
+	}
+};
@@ -0,0 +1,139 @@
+/*
+ * Offline decoder for uo_out pin streams recorded with vga_sim --pins-out.
+ *
+ * The stream is mmapped and frames are decoded in parallel, each worker
+ * with its own vga_decoder and framebuffer. The sync counters carry state
+ * across frame boundaries, so a worker first decodes the previous frame to
+ * lock onto hsync/vsync before decoding the one it owns.
+ *
+ * Usage: pins_decode [options] file.pins
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "vga_decode.hpp"
+#include "pin_stream.hpp"
+#include "frame_sink.hpp"
+
+struct decode_job {
+	std::vector<uint8_t> pins;
+	frame_t frame;
+	bool ok;
+};
+
+static void decode_frame(const pin_stream_reader& in, size_t i, bool polarity, decode_job& job)
+{
+	const vga_timing& vga = in.hdr.timing;
+	vga_decoder dec(vga);
+	job.ok = true;
+	for (size_t f = i ? i - 1 : 0; f <= i; f++) { // previous frame only locks the sync
+		if (!in.expand(f, job.pins.data())) {
+			job.ok = false;
+			return;
+		}
+		for (uint8_t p : job.pins) {
+			VGApinout_t uo_out{p};
+			dec.sync(uo_out, polarity);
+			if (f == i && dec.active()) job.frame.pixels[dec.vnum * vga.h_active_pixels + dec.hnum] = uo_out.argb();
+			dec.next();
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool polarity = false, hash = false;
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	const char* in_file = NULL, *gif_file = NULL, *raw_file = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		char* p = argv[i];
+		if (!strcmp("--polarity", p)) polarity = !polarity;
+		else if (!strcmp("--threads", p) && i + 1 < argc) threads = std::max(1, atoi(argv[++i]));
+		else if (!strcmp("--gif", p) && i + 1 < argc) gif_file = argv[++i];
+		else if (!strcmp("--raw-out", p) && i + 1 < argc) raw_file = argv[++i];
+		else if (!strcmp("--hash", p)) hash = !hash;
+		else if (p[0] != '-' && !in_file) in_file = p;
+		else in_file = NULL, i = argc;
+	}
+	if (!in_file) {
+		printf("Usage: %s [options] file.pins\n", argv[0]);
+		printf("  --polarity      \tToggles the VGA polarity sync high/low (default: %s)\n", polarity ? "true" : "false");
+		printf("  --threads [#]   \tDecoder threads (default: %d)\n", threads);
+		printf("  --gif [file]    \tSaves the decoded frames as animated GIF\n");
+		printf("  --raw-out [file]\tAppends each frame's 32-bit pixels to file\n");
+		printf("  --hash          \tToggles printing a hash of all frames (default: %s)\n", hash ? "true" : "false");
+		return 1;
+	}
+
+	pin_stream_reader in;
+	if (!in.open(in_file)) {
+		fprintf(stderr, "Unable to read pin stream %s\n", in_file);
+		return 1;
+	}
+	const vga_timing& vga = in.hdr.timing;
+	size_t frame_pixels = (size_t)vga.h_active_pixels * vga.v_active_lines;
+
+	// a batch of frames is decoded in parallel, then moved to the sinks in order
+	frame_pipeline sinks;
+	sinks.batch_size = threads;
+	int delay = ceilf(vga.frame_cycles() / (vga.clock_mhz * 10000.f)); // 100ths of a second
+	if (gif_file) {
+		gif_sink* gif = new gif_sink;
+		sinks.add(gif);
+		if (!gif->open(gif_file, vga.h_active_pixels, vga.v_active_lines, delay)) {
+			fprintf(stderr, "Unable to write GIF to %s\n", gif_file);
+			return 1;
+		}
+	}
+	if (raw_file) {
+		raw_sink* raw = new raw_sink;
+		sinks.add(raw);
+		if (!raw->open(raw_file)) {
+			fprintf(stderr, "Unable to write raw frames to %s\n", raw_file);
+			return 1;
+		}
+	}
+	if (hash) sinks.add(new hash_sink);
+
+	std::vector<decode_job> jobs(threads);
+	for (auto& job : jobs) job.pins.resize(in.hdr.frame_cycles);
+
+	using clock = std::chrono::steady_clock;
+	auto t0 = clock::now();
+	size_t decoded = 0;
+	for (size_t base = 0; base < in.frames(); base += threads) {
+		size_t n = std::min<size_t>(threads, in.frames() - base);
+		std::vector<std::thread> workers;
+		for (size_t j = 0; j < n; j++) {
+			jobs[j].frame = sinks.take(frame_pixels);
+			jobs[j].frame.index = base + j;
+			workers.emplace_back(decode_frame, std::cref(in), base + j, polarity, std::ref(jobs[j]));
+		}
+		for (auto& w : workers) w.join();
+
+		for (size_t j = 0; j < n; j++) {
+			if (!jobs[j].ok) {
+				fprintf(stderr, "Corrupt pin stream frame %zu, stopping\n", base + j);
+				base = in.frames();
+				break;
+			}
+			sinks.submit(std::move(jobs[j].frame));
+			decoded++;
+		}
+	}
+	double s = std::chrono::duration<double>(clock::now() - t0).count();
+
+	fprintf(stderr, "Decoded %zu %ux%u frames (%.1f MiB of pins%s) in %.3f s, %.1f frames/s on %d threads\n",
+		decoded, vga.h_active_pixels, vga.v_active_lines, in.size / 1048576.0,
+		in.hdr.flags & PIN_STREAM_RLE ? ", RLE" : "", s, decoded / s, threads);
+
+	sinks.finish();
+	in.close();
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if !defined(RESAMPLE_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define RESAMPLE_SIMD_WIDTH 32 // bytes per step
+#elif !defined(RESAMPLE_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define RESAMPLE_SIMD_WIDTH 16
+#endif
+
+/*
+ * Region of interest crop and integer downscale of 32-bit frames, for
+ * preview captures that are cheaper to encode than full resolution.
+ *
+ * Box filtering sums each scale x scale block per channel: the rows are
+ * accumulated into 16-bit lanes with SIMD, then each block is averaged.
+ * Nearest takes the top-left pixel of each block (AVX2 gathers them).
+ * RESAMPLE_NO_SIMD forces the scalar paths.
+ */
+
+struct capture_region {
+	int x = 0, y = 0, w = 0, h = 0; // crop in source pixels, w/h of 0 extend to the frame edge
+	int scale = 1;
+	bool box = true;                // box filter, else nearest
+
+	// "x,y[,w,h]"
+	bool parse_crop(const char* s) {
+		w = h = 0;
+		return sscanf(s, "%d,%d,%d,%d", &x, &y, &w, &h) >= 2 && x >= 0 && y >= 0 && w >= 0 && h >= 0;
+	}
+	// "N[:box|nearest]"
+	bool parse_scale(const char* s) {
+		char filter[16] = "box";
+		if (sscanf(s, "%d:%15s", &scale, filter) < 1 || scale < 1 || scale > 16) return false;
+		box = !strcmp(filter, "box");
+		return box || !strcmp(filter, "nearest");
+	}
+
+	// Clips the crop to a width x height frame, false if nothing is left
+	bool fit(int width, int height) {
+		if (!w || x + w > width) w = width - x;
+		if (!h || y + h > height) h = height - y;
+		return w >= scale && h >= scale;
+	}
+	bool identity(int width, int height) const { return x == 0 && y == 0 && w == width && h == height && scale == 1; }
+	int out_w() const { return w / scale; }
+	int out_h() const { return h / scale; }
+};
+
+// dst[oy][ox] = src[oy * s][ox * s]
+inline void resample_nearest(const uint32_t* src, int stride, uint32_t* dst, int ow, int oh, int s)
+{
+	for (int oy = 0; oy < oh; oy++) {
+		const uint32_t* row = src + (size_t)oy * s * stride;
+		uint32_t* out = dst + (size_t)oy * ow;
+		int ox = 0;
+#if RESAMPLE_SIMD_WIDTH == 32
+		const __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(s));
+		for (; ox + 8 <= ow; ox += 8)
+			_mm256_storeu_si256((__m256i*)(out + ox), _mm256_i32gather_epi32((const int*)(row + ox * s), idx, 4));
+#endif
+		for (; ox < ow; ox++) out[ox] = row[ox * s];
+	}
+}
+
+// Adds n bytes of row to the 16-bit accumulators
+inline void resample_accumulate(uint16_t* acc, const uint8_t* row, size_t n)
+{
+	size_t i = 0;
+#if RESAMPLE_SIMD_WIDTH == 32
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(row + i));
+		__m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+		__m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+		_mm256_storeu_si256((__m256i*)(acc + i), _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(acc + i)), lo));
+		_mm256_storeu_si256((__m256i*)(acc + i + 16), _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(acc + i + 16)), hi));
+	}
+#elif RESAMPLE_SIMD_WIDTH == 16
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+		_mm_storeu_si128((__m128i*)(acc + i), _mm_add_epi16(_mm_loadu_si128((const __m128i*)(acc + i)), _mm_unpacklo_epi8(v, zero)));
+		_mm_storeu_si128((__m128i*)(acc + i + 8), _mm_add_epi16(_mm_loadu_si128((const __m128i*)(acc + i + 8)), _mm_unpackhi_epi8(v, zero)));
+	}
+#endif
+	for (; i < n; i++) acc[i] += row[i];
+}
+
+// dst[oy][ox] = rounded mean of the s x s block at src[oy * s][ox * s], acc holds ow * s * 4 entries
+inline void resample_box(const uint32_t* src, int stride, uint32_t* dst, int ow, int oh, int s, uint16_t* acc)
+{
+	size_t n = (size_t)ow * s * 4;
+	unsigned area = s * s;
+	int shift = (area & (area - 1)) ? -1 : __builtin_ctz(area); // power of two scales divide by shifting
+	for (int oy = 0; oy < oh; oy++) {
+		memset(acc, 0, n * sizeof(uint16_t));
+		for (int r = 0; r < s; r++) resample_accumulate(acc, (const uint8_t*)(src + ((size_t)oy * s + r) * stride), n);
+		uint8_t* out = (uint8_t*)(dst + (size_t)oy * ow);
+		for (int ox = 0; ox < ow; ox++) {
+			const uint16_t* a = acc + (size_t)ox * s * 4;
+			for (int c = 0; c < 4; c++) {
+				unsigned sum = 0;
+				for (int k = 0; k < s; k++) sum += a[k * 4 + c];
+				out[ox * 4 + c] = shift >= 0 ? (sum + area / 2) >> shift : (sum + area / 2) / area;
+			}
+		}
+	}
+}
+
+// Crops and downscales a width-wide frame into dst (out_w x out_h)
+inline void resample(const capture_region& rg, const uint32_t* frame, int width, uint32_t* dst, std::vector<uint16_t>& acc)
+{
+	const uint32_t* src = frame + (size_t)rg.y * width + rg.x;
+	if (rg.scale == 1) {
+		for (int y = 0; y < rg.h; y++) memcpy(dst + (size_t)y * rg.w, src + (size_t)y * width, rg.w * sizeof(uint32_t));
+	} else if (rg.box) {
+		acc.resize((size_t)rg.out_w() * rg.scale * 4);
+		resample_box(src, width, dst, rg.out_w(), rg.out_h(), rg.scale, acc.data());
+	} else {
+		resample_nearest(src, width, dst, rg.out_w(), rg.out_h(), rg.scale);
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/*
+ * Triggered, windowed waveform capture for vga_sim.
+ *
+ * A trace window opens at a frame:line:pixel beam position (or when ui_in
+ * changes) and closes at a second position or after a number of cycles.
+ * While armed, the top-level pins of the last N cycles are kept in a ring
+ * so the moments leading up to the trigger can be inspected as well.
+ */
+
+// Beam position as counted by the simulation loop (frame, vnum, hnum)
+struct vga_pos {
+	int64_t frame = -1; // -1 = unset
+	int line = 0;
+	int pixel = 0;
+
+	// "frame[:line[:pixel]]"
+	bool parse(const char* s) {
+		char* end;
+		frame = strtoll(s, &end, 10);
+		line = pixel = 0;
+		if (*end == ':') line = strtol(end + 1, &end, 10);
+		if (*end == ':') pixel = strtol(end + 1, &end, 10);
+		if (*end || frame < 0) { frame = -1; return false; }
+		return true;
+	}
+	bool valid() const { return frame >= 0; }
+	bool reached(int64_t f, int l, int p) const { return f == frame && l == line && p == pixel; }
+};
+
+// One clock cycle of the top-level pins, sampled after the rising edge
+struct pin_sample {
+	uint8_t ui_in;
+	uint8_t rst_n;
+	uint8_t uo_out;
+	uint8_t pad;
+};
+
+// Circular buffer of pre-trigger pin samples
+struct pin_history {
+	std::vector<pin_sample> ring;
+	size_t head = 0, count = 0;
+
+	void resize(size_t n) { ring.assign(n, pin_sample{}); head = count = 0; }
+	void push(uint8_t ui_in, uint8_t rst_n, uint8_t uo_out) {
+		if (ring.empty()) return;
+		ring[head] = { ui_in, rst_n, uo_out, 0 };
+		if (++head == ring.size()) head = 0;
+		if (count < ring.size()) count++;
+	}
+
+	// Writes the buffered cycles as a VCD using the tb.user_project names from
+	// test/tb.gtkw. Timestamps are half clock periods, ending at end_time.
+	bool write_vcd(const char* filename, uint64_t end_time) const {
+		FILE* f = fopen(filename, "w");
+		if (!f) return false;
+		fprintf(f, "$timescale 1ps $end\n");
+		fprintf(f, "$scope module tb $end\n$scope module user_project $end\n");
+		fprintf(f, "$var wire 1 ! clk $end\n");
+		fprintf(f, "$var wire 1 \" rst_n $end\n");
+		fprintf(f, "$var wire 8 # ui_in [7:0] $end\n");
+		fprintf(f, "$var wire 8 $ uo_out [7:0] $end\n");
+		fprintf(f, "$upscope $end\n$upscope $end\n$enddefinitions $end\n");
+
+		auto bits = [](uint8_t v, char* s) { for (int i = 0; i < 8; i++) s[i] = '0' + ((v >> (7 - i)) & 1); s[8] = 0; };
+		char s[9];
+		uint64_t t = end_time - 2 * count;
+		size_t i = (head + ring.size() - count) % (ring.empty() ? 1 : ring.size());
+		for (size_t n = 0; n < count; n++, t += 2) {
+			const pin_sample& p = ring[i];
+			fprintf(f, "#%lu\n0!\n", t);
+			fprintf(f, "#%lu\n1!\n%d\"\n", t + 1, p.rst_n & 1);
+			bits(p.ui_in, s);  fprintf(f, "b%s #\n", s);
+			bits(p.uo_out, s); fprintf(f, "b%s $\n", s);
+			if (++i == ring.size()) i = 0;
+		}
+		fclose(f);
+		return true;
+	}
+};
+
+enum trace_state {
+	TRACE_OFF,
+	TRACE_ARMED,
+	TRACE_ACTIVE,
+	TRACE_DONE
+};
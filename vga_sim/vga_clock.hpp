@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+
+/*
+ * Clocking of the Verilator model, one call per pixel clock.
+ *
+ * two_phase() is the reference: a falling and a rising edge, each with an
+ * eval(). The design only has rising-edge logic (clk, and vsync for the
+ * frame counter) plus the asynchronous reset, so the falling-edge eval does
+ * no work. single() keeps clk high and instead clears Verilator's record
+ * of the previous clk value, so every eval() sees a rising edge: one eval
+ * per cycle, and inputs are only written when they change.
+ *
+ * The record is __Vtrigprevexpr___TOP__clk__0 in Verilator 5 and
+ * __Vclklast__TOP__clk in Verilator 4; with neither, single() is not
+ * available and two_phase() is used.
+ *
+ * Only vga_sim --clock-check (make clock-check) uses single() so far: it
+ * is not offered for simulation until that check has passed on a real
+ * Verilator build.
+ */
+
+template <class R, class = void> struct clk_last_v5 { static uint8_t* get(R*) { return nullptr; } };
+template <class R> struct clk_last_v5<R, std::void_t<decltype(&R::__Vtrigprevexpr___TOP__clk__0)>> {
+	static uint8_t* get(R* r) { return &r->__Vtrigprevexpr___TOP__clk__0; }
+};
+template <class R, class = void> struct clk_last_v4 { static uint8_t* get(R*) { return nullptr; } };
+template <class R> struct clk_last_v4<R, std::void_t<decltype(&R::__Vclklast__TOP__clk)>> {
+	static uint8_t* get(R* r) { return &r->__Vclklast__TOP__clk; }
+};
+
+template <class T> struct vga_clock {
+	T* top;
+	uint8_t* clk_last; // Verilator's previous clk, nullptr when unknown
+
+	vga_clock(T* model) : top(model) {
+		auto* root = model->rootp;
+		clk_last = clk_last_v5<std::remove_pointer_t<decltype(root)>>::get(root);
+		if (!clk_last) clk_last = clk_last_v4<std::remove_pointer_t<decltype(root)>>::get(root);
+	}
+
+	bool single_available() const { return clk_last != nullptr; }
+
+	// reset holds rst_n low for the rising edge, as the R key does
+	void two_phase(bool reset, uint8_t ui_in) {
+		top->clk = 0;
+		top->eval();
+		if (reset) top->rst_n = 0;
+		top->ui_in = ui_in;
+		top->clk = 1;
+		top->eval();
+		if (reset) top->rst_n = 1;
+		top->ui_in = ui_in;
+	}
+
+	void single(bool reset, uint8_t ui_in) {
+		uint8_t rst_n = !reset;
+		if (top->rst_n != rst_n) top->rst_n = rst_n;
+		if (top->ui_in != ui_in) top->ui_in = ui_in;
+		top->clk = 1;
+		*clk_last = 0;
+		top->eval();
+	}
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include "vga_timings.hpp"
+
+struct ARGB8888_t {
+	uint8_t b, g, r, a;
+	bool operator!=(const ARGB8888_t& o) const { return b != o.b || g != o.g || r != o.r || a != o.a; }
+} __attribute__((packed));
+
+union VGApinout_t {
+	uint8_t pins;
+	struct { // 6-bit color with sync
+		uint8_t r1 :1; uint8_t g1 :1; uint8_t b1 :1; uint8_t vsync :1;
+		uint8_t r0 :1; uint8_t g0 :1; uint8_t b0 :1; uint8_t hsync :1;
+	} __attribute__((packed));
+
+	// scaling for 6-bit color
+	ARGB8888_t argb() const {
+		uint8_t rr = 85 * (r1 << 1 | r0);
+		uint8_t gg = 85 * (g1 << 1 | g0);
+		uint8_t bb = 85 * (b1 << 1 | b0);
+		return { .b = bb, .g = gg, .r = rr };
+	}
+};
+
+// Beam position reconstructed from the TinyVGA PMOD sync pins
+struct vga_decoder {
+	vga_timing vga;
+	int hnum = 0;
+	int vnum = 0;
+
+	vga_decoder(const vga_timing& timing) : vga(timing) {}
+
+	// h and v blank/sync logic, call once per pixel clock before reading the position
+	void sync(VGApinout_t uo_out, bool polarity) {
+		if ((uo_out.hsync == vga.h_sync_pol) ^ polarity && (uo_out.vsync == vga.v_sync_pol) ^ polarity) {
+			hnum = -vga.h_back_porch;
+			vnum = -vga.v_back_porch;
+		}
+	}
+
+	bool active() const { return (hnum >= 0) && (hnum < vga.h_active_pixels) && (vnum >= 0) && (vnum < vga.v_active_lines); }
+
+	// keep track of encountered fields, returns true when a new line starts
+	bool next() {
+		hnum++;
+		if (hnum >= vga.h_active_pixels + vga.h_front_porch + vga.h_sync_pulse) {
+			hnum = -vga.h_back_porch;
+			vnum++;
+			return true;
+		}
+		return false;
+	}
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include "vga_timings.hpp"
+
+/*
+ * Paces simulated frames against the real refresh rate of a VGA timing.
+ * The simulation never waits for the display: frames that finish late are
+ * not presented (dropped), and time left over when the simulation runs
+ * ahead is spent re-presenting the last frame (repeated).
+ */
+struct vga_pacer {
+	using clock = std::chrono::steady_clock;
+
+	double   period;         // seconds per VGA frame
+	double   max_lag;        // schedule slips once the simulation is this far behind
+	clock::time_point start;    // schedule origin, moved forward by slips
+	clock::time_point began;    // fixed, for the achieved rate
+	uint64_t frames    = 0;  // simulated frames
+	uint64_t presented = 0;
+	uint64_t dropped   = 0;
+	uint64_t repeated  = 0;
+	uint64_t slipped   = 0;  // times the schedule was moved to match a slow host
+
+	vga_pacer(const vga_timing& vga)
+		: period(vga.frame_cycles() / (vga.clock_mhz * 1e6)), max_lag(4 * period), start(clock::now()), began(start) {}
+
+	double target_hz() const { return 1.0 / period; }
+	double elapsed() const { return std::chrono::duration<double>(clock::now() - start).count(); }
+	double achieved_hz() const { double s = std::chrono::duration<double>(clock::now() - began).count(); return s > 0 ? frames / s : 0; }
+	double lag() const { return elapsed() - frames * period; } // > 0 when behind real time
+
+	// Call once per simulated frame, returns whether it should be presented
+	bool frame_done() {
+		frames++;
+		double l = lag();
+		if (l > max_lag) { // the host can't keep up, degrade to its speed
+			start += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(l));
+			slipped++;
+		} else if (l > period) {
+			dropped++;
+			return false;
+		}
+		presented++;
+		return true;
+	}
+
+	// Seconds until the next frame is due, while ahead of real time
+	double ahead() const { double l = lag(); return l < 0 ? -l : 0; }
+};
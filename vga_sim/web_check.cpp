@@ -0,0 +1,23 @@
+/*
+ * Checks the live view's WebSocket handshake against the RFC 6455 sample:
+ * Sec-WebSocket-Key "dGhlIHNhbXBsZSBub25jZQ==" must be answered with
+ * Sec-WebSocket-Accept "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=". A wrong accept key
+ * makes every browser drop the connection before the first frame.
+ *
+ * Run with:  make web-check
+ */
+
+#include <cstdio>
+#include "web_view.hpp"
+
+int main()
+{
+	const char* expected = "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=";
+	std::string got = web_view_detail::accept_key("dGhlIHNhbXBsZSBub25jZQ==");
+	if (got != expected) {
+		fprintf(stderr, "WebSocket accept key %s, expected %s\n", got.c_str(), expected);
+		return 1;
+	}
+	fprintf(stderr, "WebSocket accept key matches RFC 6455\n");
+	return 0;
+}
@@ -0,0 +1,352 @@
+#pragma once
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "frame_sink.hpp"
+
+/*
+ * Live view for headless machines: a small HTTP server on localhost that
+ * serves a viewer page and streams frames to it over a WebSocket.
+ *
+ * Frames are sent as 6-bit RRGGBB indexes, one byte per pixel, and only
+ * for the 8x12 tiles that changed since what that client last received.
+ * All sockets are non-blocking: a frame is skipped for a client that
+ * still has unsent data, or when the frame-rate cap has not elapsed, so a
+ * slow browser never holds up the simulation.
+ *
+ * Server to client (binary):
+ *   0, u16 width, u16 height, u8 tile_w, u8 tile_h          on connect
+ *   1, u32 frame, u16 tiles, tiles * (u16 index, tile_w * tile_h bytes)
+ * Client to server (text): "d <code>" / "u <code>" with KeyboardEvent.code
+ */
+
+namespace web_view_detail {
+
+inline std::string sha1(const std::string& msg)
+{
+	uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+	std::string m = msg + '\x80';
+	while (m.size() % 64 != 56) m += '\0';
+	uint64_t bits = (uint64_t)msg.size() * 8;
+	for (int i = 7; i >= 0; i--) m += (char)(bits >> (i * 8));
+	auto rol = [](uint32_t x, int n) { return x << n | x >> (32 - n); };
+	for (size_t off = 0; off < m.size(); off += 64) {
+		uint32_t w[80];
+		for (int i = 0; i < 16; i++)
+			w[i] = (uint8_t)m[off + 4 * i] << 24 | (uint8_t)m[off + 4 * i + 1] << 16 | (uint8_t)m[off + 4 * i + 2] << 8 | (uint8_t)m[off + 4 * i + 3];
+		for (int i = 16; i < 80; i++) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		for (int i = 0; i < 80; i++) {
+			uint32_t f, k;
+			if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5a827999; }
+			else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ed9eba1; }
+			else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc; }
+			else             { f = b ^ c ^ d;                   k = 0xca62c1d6; }
+			uint32_t t = rol(a, 5) + f + e + k + w[i];
+			e = d; d = c; c = rol(b, 30); b = a; a = t;
+		}
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+	}
+	std::string out;
+	for (uint32_t v : h) for (int i = 3; i >= 0; i--) out += (char)(v >> (i * 8));
+	return out;
+}
+
+inline std::string base64(const std::string& in)
+{
+	static const char* tab = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string out;
+	for (size_t i = 0; i < in.size(); i += 3) {
+		uint32_t v = (uint8_t)in[i] << 16 | (i + 1 < in.size() ? (uint8_t)in[i + 1] << 8 : 0) | (i + 2 < in.size() ? (uint8_t)in[i + 2] : 0);
+		out += tab[v >> 18 & 63];
+		out += tab[v >> 12 & 63];
+		out += i + 1 < in.size() ? tab[v >> 6 & 63] : '=';
+		out += i + 2 < in.size() ? tab[v & 63] : '=';
+	}
+	return out;
+}
+
+// Sec-WebSocket-Accept for a Sec-WebSocket-Key (RFC 6455 section 4.2.2)
+inline std::string accept_key(const std::string& key)
+{
+	return base64(sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+}
+
+static const char* viewer_html = R"html(<!DOCTYPE html>
+<html><head><title>Tiny Tapeout VGA</title>
+<style>body{margin:0;background:#000;color:#888;font:12px monospace}canvas{display:block;margin:auto;max-width:100vw;max-height:95vh;image-rendering:pixelated}</style>
+</head><body><canvas id="c"></canvas><div id="s">connecting</div><script>
+const c = document.getElementById('c'), s = document.getElementById('s'), g = c.getContext('2d');
+const pal = new Uint32Array(64);
+for (let i = 0; i < 64; i++) pal[i] = 0xff000000 | 85 * (i & 3) << 16 | 85 * (i >> 2 & 3) << 8 | 85 * (i >> 4 & 3);
+let img, px, tw, th, frames = 0, last = performance.now();
+const ws = new WebSocket('ws://' + location.host + '/ws');
+ws.binaryType = 'arraybuffer';
+ws.onmessage = m => {
+	const d = new DataView(m.data), b = new Uint8Array(m.data);
+	if (b[0] == 0) {
+		c.width = d.getUint16(1, true); c.height = d.getUint16(3, true); tw = b[5]; th = b[6];
+		img = g.createImageData(c.width, c.height); px = new Uint32Array(img.data.buffer);
+		return;
+	}
+	const n = d.getUint16(5, true), cols = c.width / tw;
+	for (let t = 0, o = 7; t < n; t++) {
+		const i = d.getUint16(o, true), x0 = i % cols * tw, y0 = (i / cols | 0) * th;
+		o += 2;
+		for (let y = 0; y < th; y++) for (let x = 0; x < tw; x++) px[(y0 + y) * c.width + x0 + x] = pal[b[o++]];
+	}
+	g.putImageData(img, 0, 0);
+	frames++;
+	const now = performance.now();
+	if (now - last > 1000) { s.textContent = 'frame ' + d.getUint32(1, true) + ', ' + (frames * 1000 / (now - last)).toFixed(1) + ' fps'; frames = 0; last = now; }
+};
+ws.onclose = () => s.textContent = 'disconnected';
+const key = (t, e) => { if (!e.repeat && ws.readyState == 1) ws.send(t + ' ' + e.code); };
+onkeydown = e => key('d', e);
+onkeyup = e => key('u', e);
+onblur = () => { if (ws.readyState == 1) ws.send('u *'); };
+</script></body></html>
+)html";
+
+} // namespace web_view_detail
+
+struct web_sink : frame_sink {
+	enum { TILE_W = 8, TILE_H = 12, MAX_CLIENTS = 8 };
+
+	struct client {
+		int fd = -1;
+		bool ws = false;          // upgraded to WebSocket
+		bool close_after_send = false;
+		std::string in, out;      // unparsed input, unsent output
+		std::vector<uint8_t> shown; // 6-bit pixels this client has been sent
+		uint8_t ui_in = 0;
+		bool rst = false;
+	};
+
+	int listen_fd = -1;
+	int width, height;
+	double min_interval;       // seconds between frames sent, from the fps cap
+	std::chrono::steady_clock::time_point last_sent;
+	std::vector<client> clients;
+	std::vector<uint8_t> index; // current frame as 6-bit pixels
+	uint64_t sent = 0, skipped = 0, tile_bytes = 0;
+
+	web_sink(int w, int h, double max_fps) : frame_sink("web"), width(w), height(h), min_interval(max_fps > 0 ? 1.0 / max_fps : 0) {}
+	~web_sink() {
+		for (auto& c : clients) ::close(c.fd);
+		if (listen_fd >= 0) ::close(listen_fd);
+	}
+
+	bool listen(int port) {
+		listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (listen_fd < 0) return false;
+		int one = 1;
+		setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // reach it through ssh -L
+		if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) || ::listen(listen_fd, 4)) return false;
+		fcntl(listen_fd, F_SETFL, O_NONBLOCK);
+		return true;
+	}
+
+	// Inputs held down in any browser, merged with the SDL keys
+	uint8_t ui_in() const { uint8_t v = 0; for (auto& c : clients) v |= c.ui_in; return v; }
+	bool rst() const { for (auto& c : clients) if (c.rst) return true; return false; }
+
+	// Accepts, reads and flushes without blocking, call once per input poll
+	void poll() {
+		for (int fd; clients.size() < MAX_CLIENTS && (fd = accept(listen_fd, NULL, NULL)) >= 0; ) {
+			fcntl(fd, F_SETFL, O_NONBLOCK);
+			int one = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			clients.emplace_back();
+			clients.back().fd = fd;
+		}
+		for (auto& c : clients) {
+			char buf[4096];
+			ssize_t n;
+			while ((n = recv(c.fd, buf, sizeof(buf), 0)) > 0) c.in.append(buf, n);
+			if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) { // closed by the browser
+				::close(c.fd);
+				c.fd = -1;
+				continue;
+			}
+			if (c.ws) read_ws(c);
+			else read_http(c);
+			flush(c);
+		}
+		for (size_t i = 0; i < clients.size(); ) {
+			if (clients[i].fd < 0 || (clients[i].close_after_send && clients[i].out.empty())) {
+				if (clients[i].fd >= 0) ::close(clients[i].fd);
+				clients.erase(clients.begin() + i);
+			} else i++;
+		}
+	}
+
+	void write(const frame_batch& batch) override {
+		poll();
+		auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<double>(now - last_sent).count() < min_interval) return;
+
+		bool any = false;
+		for (auto& c : clients) any |= c.ws && !c.close_after_send;
+		if (!any) return;
+		last_sent = now;
+
+		const frame_t& f = batch.back();
+		index.resize(f.pixels.size());
+		for (size_t i = 0; i < index.size(); i++) {
+			ARGB8888_t p = f.pixels[i];
+			index[i] = (p.r / 85) << 4 | (p.g / 85) << 2 | p.b / 85;
+		}
+
+		int cols = width / TILE_W, rows = height / TILE_H;
+		std::string msg;
+		for (auto& c : clients) {
+			if (!c.ws || c.close_after_send) continue;
+			if (!c.out.empty()) { skipped++; continue; } // back-pressure: still sending an older frame
+			msg.assign(1, 1);
+			put(msg, (uint32_t)f.index, 4);
+			put(msg, 0, 2);
+			uint16_t tiles = 0;
+			for (int ty = 0; ty < rows; ty++) {
+				for (int tx = 0; tx < cols; tx++) {
+					bool changed = false;
+					for (int y = 0; y < TILE_H && !changed; y++) {
+						size_t o = (ty * TILE_H + y) * width + tx * TILE_W;
+						changed = memcmp(&c.shown[o], &index[o], TILE_W);
+					}
+					if (!changed) continue;
+					put(msg, ty * cols + tx, 2);
+					for (int y = 0; y < TILE_H; y++) {
+						size_t o = (ty * TILE_H + y) * width + tx * TILE_W;
+						memcpy(&c.shown[o], &index[o], TILE_W);
+						msg.append((const char*)&index[o], TILE_W);
+					}
+					tiles++;
+				}
+			}
+			if (!tiles) continue;
+			memcpy(&msg[5], &tiles, 2);
+			send_ws(c, msg, 2);
+			tile_bytes += msg.size();
+			sent++;
+			flush(c);
+		}
+	}
+
+	bool finish() override {
+		if (sent || skipped) fprintf(stderr, "Web view: %lu frames sent (%.1f KiB/frame), %lu skipped for slow clients\n",
+			sent, sent ? tile_bytes / 1024.0 / sent : 0.0, skipped);
+		return true;
+	}
+
+private:
+	static void put(std::string& s, uint32_t v, int bytes) { for (int i = 0; i < bytes; i++) s += (char)(v >> (8 * i)); }
+
+	void flush(client& c) {
+		while (!c.out.empty()) {
+			ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+			if (n <= 0) {
+				if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) { ::close(c.fd); c.fd = -1; c.out.clear(); }
+				return;
+			}
+			c.out.erase(0, n);
+		}
+	}
+
+	static void send_ws(client& c, const std::string& payload, int opcode) {
+		std::string h(1, (char)(0x80 | opcode));
+		if (payload.size() < 126) h += (char)payload.size();
+		else if (payload.size() < 65536) { h += (char)126; h += (char)(payload.size() >> 8); h += (char)payload.size(); }
+		else { h += (char)127; for (int i = 7; i >= 0; i--) h += (char)((uint64_t)payload.size() >> (8 * i)); }
+		c.out += h;
+		c.out += payload;
+	}
+
+	void read_http(client& c) {
+		size_t end = c.in.find("\r\n\r\n");
+		if (end == std::string::npos) {
+			if (c.in.size() > 16384) c.close_after_send = true;
+			return;
+		}
+		std::string req = c.in.substr(0, end);
+		c.in.clear();
+		size_t k = req.find("Sec-WebSocket-Key:");
+		if (req.compare(0, 7, "GET /ws") == 0 && k != std::string::npos) {
+			size_t v = req.find_first_not_of(' ', k + 18);
+			std::string key = req.substr(v, req.find("\r\n", v) - v);
+			c.out = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: "
+				+ web_view_detail::accept_key(key) + "\r\n\r\n";
+			c.ws = true;
+			c.shown.assign((size_t)width * height, 0xff); // nothing shown, the first frame is sent whole
+			std::string init(1, 0);
+			put(init, width, 2);
+			put(init, height, 2);
+			init += (char)TILE_W;
+			init += (char)TILE_H;
+			send_ws(c, init, 2);
+		} else if (req.compare(0, 6, "GET / ") == 0) {
+			std::string body = web_view_detail::viewer_html;
+			c.out = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nCache-Control: no-store\r\nContent-Length: " + std::to_string(body.size())
+				+ "\r\nConnection: close\r\n\r\n" + body;
+			c.close_after_send = true;
+		} else {
+			c.out = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+			c.close_after_send = true;
+		}
+	}
+
+	// Client frames are masked; handles text key events, ping and close
+	void read_ws(client& c) {
+		while (c.in.size() >= 2) {
+			const uint8_t* p = (const uint8_t*)c.in.data();
+			int opcode = p[0] & 15;
+			uint64_t len = p[1] & 127;
+			size_t hdr = 2;
+			if (len == 126) { if (c.in.size() < 4) return; len = p[2] << 8 | p[3]; hdr = 4; }
+			else if (len == 127) { if (c.in.size() < 10) return; len = 0; for (int i = 0; i < 8; i++) len = len << 8 | p[2 + i]; hdr = 10; }
+			bool masked = p[1] & 0x80;
+			if (masked) hdr += 4;
+			if (len > 4096) { c.close_after_send = true; c.in.clear(); return; }
+			if (c.in.size() < hdr + len) return;
+			std::string payload = c.in.substr(hdr, len);
+			if (masked) for (size_t i = 0; i < len; i++) payload[i] ^= p[hdr - 4 + i % 4];
+			c.in.erase(0, hdr + len);
+
+			if (opcode == 1) key_event(c, payload);
+			else if (opcode == 9) send_ws(c, payload, 10);
+			else if (opcode == 8) {
+				send_ws(c, "", 8);
+				c.close_after_send = true;
+				c.ui_in = 0;
+				c.rst = false;
+			}
+		}
+	}
+
+	// Same keys as the SDL window: 0-7 drive ui_in, R holds reset
+	static void key_event(client& c, const std::string& msg) {
+		if (msg.size() < 3) return;
+		bool down = msg[0] == 'd';
+		std::string code = msg.substr(2);
+		if (code == "*") { c.ui_in = 0; c.rst = false; }
+		else if (code == "KeyR") c.rst = down;
+		else if (code.size() == 6 && code.compare(0, 5, "Digit") == 0 && code[5] >= '0' && code[5] <= '7') {
+			uint8_t bit = 1 << (code[5] - '0');
+			c.ui_in = down ? c.ui_in | bit : c.ui_in & ~bit;
+		}
+	}
+};